@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef CMS_ALLOCATION_COUNTER_HPP
+#define CMS_ALLOCATION_COUNTER_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+/**
+ * Replaces the global operator new so benchmarks can report heap
+ * allocations per iteration. Counting is off unless an AllocationCounter
+ * is alive, so the other benchmarks only pay a relaxed load and a branch
+ * that is never taken. Must be included by exactly one translation unit,
+ * which microbench.cpp is.
+ */
+namespace bench {
+
+inline std::atomic<size_t> heapAllocations{0};
+inline std::atomic<unsigned> activeCounters{0};
+
+// Counts allocations while alive and reports them as a per-iteration
+// counter.
+class AllocationCounter {
+public:
+  AllocationCounter() {
+    activeCounters.fetch_add(1);
+    start = heapAllocations.load();
+  }
+  ~AllocationCounter() { activeCounters.fetch_sub(1); }
+
+  AllocationCounter(const AllocationCounter &) = delete;
+  AllocationCounter &operator=(const AllocationCounter &) = delete;
+
+  size_t count() const { return heapAllocations.load() - start; }
+
+  void report(benchmark::State &state, size_t extra = 0) const {
+    state.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(count() + extra),
+        benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  size_t start = 0;
+};
+
+} // namespace bench
+
+namespace bench {
+
+// Out of line, so GCC does not pair inlined malloc/free with new/delete.
+[[gnu::noinline]] void *countedAllocate(size_t size) {
+  if (activeCounters.load(std::memory_order_relaxed) != 0) [[unlikely]] {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void *pointer = std::malloc(size ? size : 1)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void countedFree(void *pointer) noexcept {
+  std::free(pointer);
+}
+
+} // namespace bench
+
+void *operator new(size_t size) { return bench::countedAllocate(size); }
+void *operator new[](size_t size) { return bench::countedAllocate(size); }
+
+void operator delete(void *pointer) noexcept { bench::countedFree(pointer); }
+void operator delete[](void *pointer) noexcept { bench::countedFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept {
+  bench::countedFree(pointer);
+}
+void operator delete[](void *pointer, size_t) noexcept {
+  bench::countedFree(pointer);
+}
+
+#endif // CMS_ALLOCATION_COUNTER_HPP
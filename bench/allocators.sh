@@ -0,0 +1,161 @@
+#!/usr/bin/env bash
+# -*- mode: shell-script; indent-tabs-mode: nil; sh-basic-offset: 4; -*-
+# ex: ts=8 sw=4 sts=4 et filetype=sh
+#
+#  allocators.sh
+#
+#  Copyright © 2010 — 2025 Randolph Ledesma
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Compares heap allocators under replayed production traffic. For each of
+# glibc, mimalloc and jemalloc: build the server with -Dallocator=<name>,
+# serve the fixture from the memory store, replay the capture at full speed
+# over and over for SECONDS (default an hour), then read RSS and allocator
+# statistics from the metrics endpoint. Allocators whose library is not
+# installed are skipped.
+#
+# usage: bench/allocators.sh CAPTURE [SECONDS] [ALLOCATORS...]
+
+set -euo pipefail
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 CAPTURE [SECONDS] [ALLOCATORS...]" >&2
+    exit 2
+fi
+
+CAPTURE=$(realpath "$1")
+shift
+SECONDS_PER_RUN=3600
+if [ $# -gt 0 ]; then
+    SECONDS_PER_RUN=$1
+    shift
+fi
+ALLOCATORS=(system mimalloc jemalloc)
+if [ $# -gt 0 ]; then
+    ALLOCATORS=("$@")
+fi
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+FIXTURE="$ROOT/resources/database/fixture.json"
+METRICS="http://127.0.0.1:10001/_cms/metrics"
+RESULTS=$(mktemp -d)
+SERVER_PID=
+
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+        SERVER_PID=
+    fi
+}
+trap stop_server EXIT
+
+# start_server ALLOCATOR BINARY: serve the fixture; false if the metrics
+# endpoint does not answer within ten seconds
+start_server() {
+    CMS_CONTENT_STORE="memory:$FIXTURE" CMS_RESOURCE_SAMPLE_SECONDS=1 \
+        "$2" >"$RESULTS/$1-server.log" 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 100); do
+        if curl -sf -o /dev/null "$METRICS"; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    stop_server
+    return 1
+}
+
+# replay ALLOCATOR BINARY: replay the capture once and print "requests
+# seconds", or nothing when the replay wrote no result
+replay() {
+    rm -f "$RESULTS/replay.json"
+    "$2" "$CAPTURE" --target 127.0.0.1:10000 --speed 0 \
+        --json "$RESULTS/replay.json" >>"$RESULTS/$1-replay.log" 2>&1 || true
+    sed -nE 's/.*"requests":([0-9]+).*"wallSeconds":([0-9.]+).*/\1 \2/p' \
+        "$RESULTS/replay.json" 2>/dev/null || true
+}
+
+metric() {
+    awk -v name="$1" '$1 == name || index($1, name "{") == 1 {
+        print $2
+        exit
+    }' "$2"
+}
+
+printf "%-10s %12s %10s %12s %12s %12s %8s\n" \
+    allocator requests "req/s" "rss MiB" "peak MiB" "held MiB" frag
+for allocator in "${ALLOCATORS[@]}"; do
+    build="$ROOT/_alloc-$allocator"
+    if [ -d "$build" ]; then
+        configure=(meson configure "$build")
+    else
+        configure=(meson setup "$build" "$ROOT")
+    fi
+    if ! "${configure[@]}" -Dallocator="$allocator" \
+        >"$RESULTS/$allocator-setup.log" 2>&1; then
+        echo "$allocator: not available, see $RESULTS/$allocator-setup.log" >&2
+        continue
+    fi
+    if ! meson compile -C "$build" cms cms-replay \
+        >"$RESULTS/$allocator-build.log" 2>&1; then
+        echo "$allocator: build failed, see $RESULTS/$allocator-build.log" >&2
+        continue
+    fi
+
+    if ! start_server "$allocator" "$build/cms"; then
+        echo "$allocator: server did not start," \
+            "see $RESULTS/$allocator-server.log" >&2
+        continue
+    fi
+
+    requests=0
+    wall=0
+    failed=
+    end=$(($(date +%s) + SECONDS_PER_RUN))
+    while [ "$(date +%s)" -lt "$end" ]; do
+        result=$(replay "$allocator" "$build/cms-replay")
+        if [ -z "$result" ]; then
+            failed=1
+            break
+        fi
+        read -r count seconds <<<"$result"
+        requests=$((requests + count))
+        wall=$(awk -v a="$wall" -v b="$seconds" 'BEGIN { print a + b }')
+    done
+
+    sleep 2 # one more resource sample after the last request
+    if [ -n "$failed" ] ||
+        ! curl -sf "$METRICS" >"$RESULTS/$allocator.metrics"; then
+        stop_server
+        echo "$allocator: replay failed, see $RESULTS/$allocator-replay.log" \
+            "and $RESULTS/$allocator-server.log" >&2
+        continue
+    fi
+    stop_server
+
+    m="$RESULTS/$allocator.metrics"
+    awk -v name="$allocator" -v requests="$requests" -v wall="$wall" \
+        -v rss="$(metric cms_process_resident_memory_bytes "$m")" \
+        -v peak="$(metric cms_process_resident_memory_peak_bytes "$m")" \
+        -v held="$(metric cms_allocator_held_bytes "$m")" \
+        -v frag="$(metric cms_allocator_fragmentation_ratio "$m")" \
+        'BEGIN {
+            printf "%-10s %12d %10.0f %12.1f %12.1f %12.1f %8s\n", name,
+                requests, (wall > 0 ? requests / wall : 0), rss / 1048576,
+                peak / 1048576, held / 1048576,
+                frag == "" ? "-" : sprintf("%.3f", frag)
+        }'
+done
+echo "logs and metrics in $RESULTS"
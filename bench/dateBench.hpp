@@ -0,0 +1,94 @@
+#pragma once
+
+#ifndef CMS_DATE_BENCH_HPP
+#define CMS_DATE_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/dateService.hpp"
+#include "include/stringUtil.hpp"
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+constexpr int64_t kCreatedAt = 1749724380000; // Thu, June 12, 2025 10:33 UTC
+
+// The previous string_util::timestamp: gmtime and strftime on every call.
+std::string strftimeTimestamp(int64_t millis) {
+  std::time_t seconds = millis / 1000;
+  char buffer[40];
+  std::strftime(buffer, sizeof(buffer), "%a, %B %d, %Y at %I:%M %p UTC",
+                std::gmtime(&seconds));
+  return buffer;
+}
+
+void BM_ContentDateStrftime(benchmark::State &state) {
+  for (auto _ : state) {
+    auto date = strftimeTimestamp(kCreatedAt);
+    benchmark::DoNotOptimize(date);
+  }
+}
+BENCHMARK(BM_ContentDateStrftime);
+
+void BM_ContentDateFormat(benchmark::State &state) {
+  char buffer[services::kContentDateMaxSize];
+  for (auto _ : state) {
+    auto size = services::formatContentDate(kCreatedAt, buffer);
+    benchmark::DoNotOptimize(buffer);
+    benchmark::DoNotOptimize(size);
+  }
+}
+BENCHMARK(BM_ContentDateFormat);
+
+// Cache hits: the same few documents rendered over and over.
+void BM_ContentDateCached(benchmark::State &state) {
+  int64_t i = 0;
+  for (auto _ : state) {
+    auto date = services::ContentDateCache::format(kCreatedAt +
+                                                   (i++ % 8) * 86400000);
+    benchmark::DoNotOptimize(date);
+  }
+}
+BENCHMARK(BM_ContentDateCached);
+
+void BM_StringUtilTimestamp(benchmark::State &state) {
+  bsoncxx::types::b_date date{std::chrono::milliseconds(kCreatedAt)};
+  for (auto _ : state) {
+    auto text = string_util::timestamp(date);
+    benchmark::DoNotOptimize(text);
+  }
+}
+BENCHMARK(BM_StringUtilTimestamp);
+
+void BM_HttpDateFormat(benchmark::State &state) {
+  std::time_t now = std::time(nullptr);
+  for (auto _ : state) {
+    auto date = services::formatHttpDate(now);
+    benchmark::DoNotOptimize(date);
+  }
+}
+BENCHMARK(BM_HttpDateFormat);
+
+// What a response pays for its Date header once the clock is running.
+void BM_HttpDateClockNow(benchmark::State &state) {
+  // Outlives the clock's timer: constructed first, destroyed after it.
+  static boost::asio::io_context ioc;
+  services::HttpDateClock::instance().start(ioc);
+  for (auto _ : state) {
+    auto date = services::HttpDateClock::instance().now();
+    benchmark::DoNotOptimize(date);
+  }
+}
+BENCHMARK(BM_HttpDateClockNow);
+
+} // namespace bench
+
+#endif // CMS_DATE_BENCH_HPP
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef CMS_HTML_ESCAPE_BENCH_HPP
+#define CMS_HTML_ESCAPE_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/htmlEscape.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+// Plain text of the given size; every `every` bytes one character needs
+// escaping (0: none does).
+std::string makePlainText(size_t size, size_t every) {
+  std::string text;
+  text.reserve(size);
+  constexpr std::string_view kWords = "plain text with words and spaces ";
+  while (text.size() < size) {
+    text.append(kWords);
+  }
+  text.resize(size);
+  if (every > 0) {
+    constexpr std::string_view kSpecials = "&<>\"'";
+    for (size_t i = every / 2, n = 0; i < size; i += every, ++n) {
+      text[i] = kSpecials[n % kSpecials.size()];
+    }
+  }
+  return text;
+}
+
+// Byte-at-a-time escaping, for comparison.
+std::string scalarHtmlEscape(std::string_view text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (char byte : text) {
+    if (cms::detail::isHtmlSpecial(byte)) {
+      escaped.append(cms::detail::htmlEntity(byte));
+    } else {
+      escaped.push_back(byte);
+    }
+  }
+  return escaped;
+}
+
+// An input htmlEscape escapes differently from scalarHtmlEscape, or none.
+// Every length up to three AVX2 vectors is tried with a special character
+// at each offset and another at the end, so matches inside a vector, on
+// either side of a block boundary and in the scalar tail are all compared.
+std::optional<std::string> htmlEscapeMismatch() {
+  constexpr std::string_view kSpecials = "&<>\"'";
+  for (size_t size = 0; size <= 96; ++size) {
+    auto clean = makePlainText(size, 0);
+    if (cms::htmlEscape(clean) != scalarHtmlEscape(clean)) {
+      return clean;
+    }
+    for (size_t at = 0; at < size; ++at) {
+      auto text = clean;
+      text[at] = kSpecials[at % kSpecials.size()];
+      text.back() = kSpecials[size % kSpecials.size()];
+      if (cms::htmlEscape(text) != scalarHtmlEscape(text)) {
+        return text;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+// False, with the benchmark marked failed, if the vector search is wrong:
+// a fast wrong answer is not worth timing.
+bool htmlEscapeChecked(benchmark::State &state) {
+  static const auto mismatch = htmlEscapeMismatch();
+  if (mismatch) {
+    state.SkipWithError(
+        ("htmlEscape differs from scalarHtmlEscape on \"" + *mismatch + "\"")
+            .c_str());
+    return false;
+  }
+  return true;
+}
+
+void BM_HtmlEscapeClean(benchmark::State &state) {
+  if (!htmlEscapeChecked(state)) {
+    return;
+  }
+  auto text = makePlainText(static_cast<size_t>(state.range(0)), 0);
+  for (auto _ : state) {
+    auto escaped = cms::htmlEscape(text);
+    benchmark::DoNotOptimize(escaped);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_HtmlEscapeClean)->Range(64, 256 << 10);
+
+// One character in a hundred needs escaping.
+void BM_HtmlEscapeSparse(benchmark::State &state) {
+  if (!htmlEscapeChecked(state)) {
+    return;
+  }
+  auto text = makePlainText(static_cast<size_t>(state.range(0)), 100);
+  for (auto _ : state) {
+    auto escaped = cms::htmlEscape(text);
+    benchmark::DoNotOptimize(escaped);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_HtmlEscapeSparse)->Range(64, 256 << 10);
+
+void BM_HtmlEscapeScalar(benchmark::State &state) {
+  auto text = makePlainText(static_cast<size_t>(state.range(0)), 100);
+  for (auto _ : state) {
+    auto escaped = scalarHtmlEscape(text);
+    benchmark::DoNotOptimize(escaped);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_HtmlEscapeScalar)->Range(64, 256 << 10);
+
+} // namespace bench
+
+#endif // CMS_HTML_ESCAPE_BENCH_HPP
@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef CMS_HTTP_ROUTING_BENCH_HPP
+#define CMS_HTTP_ROUTING_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/httpServer.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+// Request targets a public site sees, pages and posts and their assets.
+constexpr std::array<std::string_view, 8> kRequestTargets{
+    "/",
+    "/about",
+    "/posts/1",
+    "/posts/1274",
+    "/posts/why-everyone-talking-about-cpp/2",
+    "/css/site.min.css",
+    "/images/header.webp",
+    "/favicon.ico",
+};
+
+// Extension lookup, which walks the list until one matches; .ico is near
+// the end and an unknown extension goes through all of it.
+void BM_MimeType(benchmark::State &state) {
+  size_t next = 0;
+  for (auto _ : state) {
+    auto type = mime_type(kRequestTargets[next++ % kRequestTargets.size()]);
+    benchmark::DoNotOptimize(type);
+  }
+}
+BENCHMARK(BM_MimeType);
+
+void BM_PathCat(benchmark::State &state) {
+  size_t next = 0;
+  for (auto _ : state) {
+    auto path = path_cat("/var/www/cms/public",
+                         kRequestTargets[next++ % kRequestTargets.size()]);
+    benchmark::DoNotOptimize(path);
+  }
+}
+BENCHMARK(BM_PathCat);
+
+// URL parsing and segment walk handle_request does to find the content.
+void BM_RouteContent(benchmark::State &state) {
+  size_t next = 0;
+  for (auto _ : state) {
+    auto route = route_content(
+        "localhost", kRequestTargets[next++ % kRequestTargets.size()]);
+    benchmark::DoNotOptimize(route);
+  }
+}
+BENCHMARK(BM_RouteContent);
+
+} // namespace bench
+
+#endif // CMS_HTTP_ROUTING_BENCH_HPP
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef CMS_KEY_VALUE_CACHE_BENCH_HPP
+#define CMS_KEY_VALUE_CACHE_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/keyValueCache.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+constexpr int64_t kCacheTtlSeconds = 3600;
+constexpr size_t kCacheValueSize = 256;
+
+// Keys shaped like the page cache's: database, collection and id.
+std::vector<std::string> makeCacheKeys(size_t count) {
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    keys.push_back("localhost:posts:" + std::to_string(i + 1));
+  }
+  return keys;
+}
+
+// A cache filled to capacity with the given keys.
+std::unique_ptr<services::KeyValueCache>
+makeFullCache(const std::vector<std::string> &keys) {
+  auto cache = std::make_unique<services::KeyValueCache>(keys.size());
+  for (const auto &key : keys) {
+    cache->set(key, std::string(kCacheValueSize, 'x'), kCacheTtlSeconds);
+  }
+  return cache;
+}
+
+// Hits spread evenly over every key of one cache shared by all threads.
+void BM_KeyValueCacheGet(benchmark::State &state) {
+  static std::vector<std::string> keys;
+  static std::unique_ptr<services::KeyValueCache> cache;
+  if (state.thread_index() == 0) {
+    keys = makeCacheKeys(static_cast<size_t>(state.range(0)));
+    cache = makeFullCache(keys);
+  }
+  size_t next = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    auto value = cache->get(keys[next++ % keys.size()]);
+    benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_KeyValueCacheGet)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// Replacing the value of keys already present, as a refresh does.
+void BM_KeyValueCacheSet(benchmark::State &state) {
+  static std::vector<std::string> keys;
+  static std::unique_ptr<services::KeyValueCache> cache;
+  if (state.thread_index() == 0) {
+    keys = makeCacheKeys(static_cast<size_t>(state.range(0)));
+    cache = makeFullCache(keys);
+  }
+  std::string value(kCacheValueSize, 'y');
+  size_t next = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    bool stored = cache->set(keys[next++ % keys.size()], value,
+                             kCacheTtlSeconds);
+    benchmark::DoNotOptimize(stored);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_KeyValueCacheSet)
+    ->RangeMultiplier(4)
+    ->Range(16, 1024)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+} // namespace bench
+
+#endif // CMS_KEY_VALUE_CACHE_BENCH_HPP
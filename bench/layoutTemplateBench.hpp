@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef CMS_LAYOUT_TEMPLATE_BENCH_HPP
+#define CMS_LAYOUT_TEMPLATE_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/layoutTemplate.hpp"
+#include "include/stringUtil.hpp"
+
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+// The seeded default layout (resources/database/seed.js).
+constexpr std::string_view kLayoutHeader = R"(<!DOCTYPE html>
+<html lang="en">
+  <head>
+    <meta charset="UTF-8">
+    <meta name="viewport" content="width=device-width, initial-scale=1.0">
+    <title>%REPLACE_WITH_TITLE_ID%</title>
+
+    <!-- SEO Meta Tags -->
+    <meta name="description" content="Randolph Ledesma">
+    <meta name="keywords" content="Randolph Ledesma">
+    <meta name="author" content="Randolph Ledesma">
+    <meta name="robots" content="index, follow">
+
+    <meta name="theme-color" content="#ffffff">
+    <meta http-equiv="X-UA-Compatible" content="IE=edge">
+  </head>
+  <body>)";
+constexpr std::string_view kLayoutFooter = "</body></html>";
+constexpr std::string_view kTitle = "Hello World";
+
+std::string makeBody(size_t size) {
+  constexpr std::string_view kParagraph =
+      "<p>Lorem ipsum dolor sit amet, consectetur adipiscing elit. Nulla "
+      "ornare suscipit justo, vel tempor ligula pellentesque ac.</p>\n";
+  std::string body;
+  body.reserve(size + kParagraph.size());
+  while (body.size() < size) {
+    body.append(kParagraph);
+  }
+  return body;
+}
+
+void BM_LayoutTemplateCompile(benchmark::State &state) {
+  for (auto _ : state) {
+    cms::LayoutTemplate layout(kLayoutHeader, kLayoutFooter, 1);
+    benchmark::DoNotOptimize(layout);
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          (kLayoutHeader.size() + kLayoutFooter.size()));
+}
+BENCHMARK(BM_LayoutTemplateCompile);
+
+void BM_LayoutTemplateRender(benchmark::State &state) {
+  cms::LayoutTemplate layout(kLayoutHeader, kLayoutFooter, 1);
+  auto body = makeBody(static_cast<size_t>(state.range(0)));
+  cms::LayoutSlotValues slots;
+  slots[cms::LayoutSlot::Title] = kTitle;
+  slots[cms::LayoutSlot::Body] = body;
+  for (auto _ : state) {
+    auto page = layout.render(slots);
+    benchmark::DoNotOptimize(page);
+  }
+  state.SetBytesProcessed(state.iterations() * layout.size(slots));
+}
+BENCHMARK(BM_LayoutTemplateRender)->Range(4 << 10, 512 << 10);
+
+// The previous approach: assemble the page, then replace the title tag.
+void BM_LayoutConcatReplace(benchmark::State &state) {
+  auto body = makeBody(static_cast<size_t>(state.range(0)));
+  std::string titleTag = "<title>" + std::string(kTitle) + "</title>";
+  string_util::StringReplacer replacer("<title>%REPLACE_WITH_TITLE_ID%</title>",
+                                       titleTag);
+  size_t pageSize = 0;
+  for (auto _ : state) {
+    std::string content;
+    content.append(kLayoutHeader);
+    content.append(body);
+    content.append(kLayoutFooter);
+    auto page = replacer.replace(content, 1);
+    pageSize = page.size();
+    benchmark::DoNotOptimize(page);
+  }
+  state.SetBytesProcessed(state.iterations() * pageSize);
+}
+BENCHMARK(BM_LayoutConcatReplace)->Range(4 << 10, 512 << 10);
+
+} // namespace bench
+
+#endif // CMS_LAYOUT_TEMPLATE_BENCH_HPP
@@ -0,0 +1,670 @@
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/httpServer.hpp"
+#include "include/memoryContentStore.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/json.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#ifndef CMS_BENCH_FIXTURE
+#define CMS_BENCH_FIXTURE "resources/database/fixture.json"
+#endif
+
+/***
+###############################################################################
+# Namespaces
+###############################################################################
+***/
+
+namespace po = boost::program_options;
+
+/**
+ * cms-bench: HTTP/1.1 load generator for the server.
+ *
+ * By default each run starts the real listener and sessions in-process on
+ * 127.0.0.1, backed by the in-memory content store loaded from the fixture,
+ * and drives them over loopback; --target points it at a running server
+ * instead (e.g. one connected to a local mongod, or one serving the content
+ * --prepare-target writes, as pgo.sh trains it). Closed loop keeps every
+ * connection busy back to back. Open loop (--rate) issues requests on a
+ * fixed schedule and measures each from when it was due rather than when a
+ * connection got to send it, so a stalled server shows up in the latencies
+ * instead of slowing the load down (coordinated omission).
+ */
+namespace bench {
+
+enum class RequestKind : uint8_t { Hit, Miss, Static, NotFound };
+
+constexpr std::array<std::string_view, 4> kRequestKindNames{
+    "hit", "miss", "static", "notfound"};
+
+// Pages the fixture has, served from the page cache once warm.
+constexpr std::array<std::string_view, 4> kCachedTargets{"/", "/about",
+                                                         "/posts/1", "/posts/2"};
+// Synthetic posts are numbered from here, far more than the cache holds.
+constexpr int kFirstMissPost = 1000;
+constexpr std::string_view kStaticTarget = "/bench.css";
+constexpr size_t kStaticFileSize = 16 << 10;
+
+struct Options {
+  std::string target; // host:port of a running server; empty for in-process
+  std::string fixture = CMS_BENCH_FIXTURE;
+  std::vector<int> serverThreads{1};
+  int clientThreads = 1;
+  int connections = 32;
+  double rate = 0; // requests per second over all connections; 0 closed loop
+  std::chrono::milliseconds duration{5000};
+  std::chrono::milliseconds warmup{1000};
+  std::array<unsigned, 4> mix{70, 10, 10, 10}; // by RequestKind
+  int missPosts = 2000;
+  std::string jsonPath;
+};
+
+struct RunResult {
+  int serverThreads = 0;
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  std::vector<uint32_t> latencies; // microseconds, sorted
+
+  double requestsPerSecond() const {
+    return seconds > 0 ? requests / seconds : 0;
+  }
+  double megabytesPerSecond() const {
+    return seconds > 0 ? bytes / seconds / 1e6 : 0;
+  }
+  double percentileMillis(double quantile) const {
+    if (latencies.empty()) {
+      return 0;
+    }
+    size_t index = std::min(latencies.size() - 1,
+                            static_cast<size_t>(quantile * latencies.size()));
+    return latencies[index] / 1000.0;
+  }
+};
+
+//------------------------------------------------------------------------------
+
+// Copies of the fixture's first localhost post, numbered from kFirstMissPost,
+// so misses can be generated without exhausting the ids.
+std::vector<bsoncxx::document::value>
+missPostCopies(const Options &options, bsoncxx::document::view fixture) {
+  auto posts = fixture["localhost"]["posts"];
+  if (!posts || posts.type() != bsoncxx::type::k_array) {
+    throw std::runtime_error("fixture has no localhost posts to copy");
+  }
+  auto first = posts.get_array().value[0];
+  if (!first || first.type() != bsoncxx::type::k_document) {
+    throw std::runtime_error("fixture has no localhost posts to copy");
+  }
+  auto post = first.get_document().value;
+  std::vector<bsoncxx::document::value> copies;
+  copies.reserve(options.missPosts);
+  for (int i = 0; i < options.missPosts; ++i) {
+    bsoncxx::builder::basic::document copy;
+    copy.append(bsoncxx::builder::basic::kvp(
+        std::string(cms::kDocumentIdField), kFirstMissPost + i));
+    for (const auto &element : post) {
+      if (element.key() != cms::kDocumentIdField) {
+        copy.append(bsoncxx::builder::basic::kvp(element.key(),
+                                                 element.get_value()));
+      }
+    }
+    copies.push_back(copy.extract());
+  }
+  return copies;
+}
+
+bsoncxx::document::value readFixture(const Options &options) {
+  std::ifstream file(options.fixture, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to open fixture: " + options.fixture);
+  }
+  std::stringstream json;
+  json << file.rdbuf();
+  return bsoncxx::from_json(json.str());
+}
+
+// Content store for in-process runs: the fixture plus the miss posts.
+std::shared_ptr<cms::MemoryContentStore> makeStore(const Options &options) {
+  auto store = cms::MemoryContentStore::fromJsonFile(options.fixture);
+  auto fixture = readFixture(options);
+  for (auto &copy : missPostCopies(options, fixture.view())) {
+    store->put("localhost", "posts", std::move(copy));
+  }
+  return store;
+}
+
+// Write what a --target server needs for the whole mix into directory:
+// fixture.json with the miss posts, for CMS_CONTENT_STORE=memory:..., and
+// the static file, with directory as its DOC_ROOT.
+void prepareTarget(const Options &options, const std::string &directory) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::sub_array;
+  using bsoncxx::builder::basic::sub_document;
+
+  auto fixture = readFixture(options);
+  auto copies = missPostCopies(options, fixture.view());
+  bsoncxx::builder::basic::document content;
+  for (const auto &database : fixture.view()) {
+    if (database.key() != "localhost" ||
+        database.type() != bsoncxx::type::k_document) {
+      content.append(kvp(database.key(), database.get_value()));
+      continue;
+    }
+    content.append(kvp(database.key(), [&](sub_document collections) {
+      for (const auto &collection : database.get_document().value) {
+        if (collection.key() != "posts") {
+          collections.append(kvp(collection.key(), collection.get_value()));
+          continue;
+        }
+        collections.append(kvp(collection.key(), [&](sub_array posts) {
+          for (const auto &post : collection.get_array().value) {
+            posts.append(post.get_value());
+          }
+          for (const auto &copy : copies) {
+            posts.append(copy.view());
+          }
+        }));
+      }
+    }));
+  }
+
+  std::filesystem::create_directories(directory);
+  std::ofstream(directory + "/fixture.json", std::ios::binary)
+      << bsoncxx::to_json(content.view(), bsoncxx::ExtendedJsonMode::k_relaxed);
+  std::ofstream(directory + std::string(kStaticTarget))
+      << std::string(kStaticFileSize, 'x');
+}
+
+// The server stack main() runs, on its own io_context and threads.
+class InProcessServer {
+public:
+  InProcessServer(std::shared_ptr<cms::ContentStore> store,
+                  std::shared_ptr<std::string const> docRoot, int threads)
+      : ioc(threads), cache(kPageCacheSize) {
+    auto content = std::make_shared<cms::Content>(store, std::ref(cache));
+    auto page = std::make_shared<cms::Page>(content);
+    auto post = std::make_shared<cms::Post>(content);
+    auto server = std::make_shared<listener>(
+        ioc, tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, docRoot,
+        post, page);
+    server->run();
+    endpoint_ = server->local_endpoint();
+    for (int i = 0; i < threads; ++i) {
+      workers.emplace_back([this] { ioc.run(); });
+    }
+  }
+
+  ~InProcessServer() {
+    ioc.stop();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  tcp::endpoint endpoint() const { return endpoint_; }
+
+private:
+  static constexpr size_t kPageCacheSize = 25; // as main() configures it
+
+  net::io_context ioc;
+  cms::PageCache cache;
+  tcp::endpoint endpoint_;
+  std::vector<std::thread> workers;
+};
+
+//------------------------------------------------------------------------------
+
+// State shared by the connections of one run.
+struct LoadRun {
+  const Options &options;
+  tcp::endpoint endpoint;
+  std::string host;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point measureFrom;
+  std::chrono::steady_clock::time_point end;
+  std::chrono::nanoseconds interval{0}; // between requests, open loop
+  std::atomic<uint64_t> nextSlot{0};
+};
+
+// Per-connection tallies, merged once the run is over.
+struct ConnectionStats {
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  uint64_t bytes = 0;
+  std::vector<uint32_t> latencies;
+};
+
+// One keep-alive client connection issuing requests one at a time.
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+  Connection(net::io_context &ioc, LoadRun &run, ConnectionStats &stats,
+             uint64_t seed)
+      : stream(net::make_strand(ioc)), timer(stream.get_executor()),
+        run(run), stats(stats), random(seed) {}
+
+  void start() {
+    stream.async_connect(run.endpoint,
+                         beast::bind_front_handler(&Connection::on_connect,
+                                                   shared_from_this()));
+  }
+
+private:
+  void on_connect(beast::error_code ec) {
+    if (ec) {
+      ++stats.errors;
+      return;
+    }
+    next();
+  }
+
+  void next() {
+    auto now = std::chrono::steady_clock::now();
+    if (run.options.rate <= 0) {
+      due = now;
+    } else {
+      due = run.start + run.interval * run.nextSlot++;
+    }
+    if (due >= run.end) {
+      return;
+    }
+    if (due > now) {
+      timer.expires_at(due);
+      timer.async_wait([self = shared_from_this()](beast::error_code ec) {
+        if (!ec) {
+          self->send();
+        }
+      });
+      return;
+    }
+    send();
+  }
+
+  void send() {
+    request = {};
+    request.version(11);
+    request.method(http::verb::get);
+    request.target(pick_target());
+    request.set(http::field::host, run.host);
+    request.set(http::field::user_agent, "cms-bench");
+    request.keep_alive(true);
+    http::async_write(stream, request,
+                      beast::bind_front_handler(&Connection::on_write,
+                                                shared_from_this()));
+  }
+
+  void on_write(beast::error_code ec, std::size_t) {
+    if (ec) {
+      return failed();
+    }
+    response.emplace();
+    response->body_limit(64 << 20);
+    http::async_read(stream, buffer, *response,
+                     beast::bind_front_handler(&Connection::on_read,
+                                               shared_from_this()));
+  }
+
+  void on_read(beast::error_code ec, std::size_t bytes) {
+    if (ec) {
+      return failed();
+    }
+    if (due >= run.measureFrom) {
+      auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - due);
+      ++stats.requests;
+      stats.bytes += bytes;
+      stats.latencies.push_back(static_cast<uint32_t>(latency.count()));
+      auto status = response->get().result_int();
+      bool expected = expected_kind == RequestKind::NotFound
+                          ? status == 404
+                          : status == 200;
+      if (!expected) {
+        ++stats.errors;
+      }
+    }
+    bool keep_alive = response->get().keep_alive();
+    response.reset();
+    if (!keep_alive) {
+      return reconnect();
+    }
+    next();
+  }
+
+  // The server dropped the connection, e.g. after a 503: count it and carry
+  // on with a new one so the load holds.
+  void failed() {
+    ++stats.errors;
+    reconnect();
+  }
+
+  void reconnect() {
+    if (std::chrono::steady_clock::now() >= run.end) {
+      return;
+    }
+    beast::error_code ignored;
+    stream.socket().close(ignored);
+    buffer.clear();
+    start();
+  }
+
+  std::string pick_target() {
+    unsigned total = 0;
+    for (auto weight : run.options.mix) {
+      total += weight;
+    }
+    unsigned roll = std::uniform_int_distribution<unsigned>(0, total - 1)(random);
+    size_t kind = 0;
+    while (roll >= run.options.mix[kind]) {
+      roll -= run.options.mix[kind++];
+    }
+    expected_kind = static_cast<RequestKind>(kind);
+    switch (expected_kind) {
+    case RequestKind::Hit:
+      return std::string(kCachedTargets[random() % kCachedTargets.size()]);
+    case RequestKind::Miss:
+      return "/posts/" +
+             std::to_string(kFirstMissPost +
+                            random() % std::max(1, run.options.missPosts));
+    case RequestKind::Static:
+      return std::string(kStaticTarget);
+    default:
+      return "/missing-" + std::to_string(random() % 100000) + ".html";
+    }
+  }
+
+  beast::tcp_stream stream;
+  net::steady_timer timer;
+  beast::flat_buffer buffer;
+  http::request<http::empty_body> request;
+  std::optional<http::response_parser<http::string_body>> response;
+  LoadRun &run;
+  ConnectionStats &stats;
+  std::mt19937_64 random;
+  std::chrono::steady_clock::time_point due;
+  RequestKind expected_kind = RequestKind::Hit;
+};
+
+RunResult runLoad(const Options &options, tcp::endpoint endpoint,
+                  std::string host, int serverThreads) {
+  net::io_context ioc(options.clientThreads);
+  auto start = std::chrono::steady_clock::now();
+  LoadRun run{options,
+              endpoint,
+              std::move(host),
+              start,
+              start + options.warmup,
+              start + options.warmup + options.duration};
+  if (options.rate > 0) {
+    run.interval = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 / options.rate));
+  }
+
+  std::vector<ConnectionStats> stats(options.connections);
+  for (int i = 0; i < options.connections; ++i) {
+    std::make_shared<Connection>(ioc, run, stats[i], 0x5eed + i)->start();
+  }
+  std::vector<std::thread> clients;
+  for (int i = 1; i < options.clientThreads; ++i) {
+    clients.emplace_back([&ioc] { ioc.run(); });
+  }
+  ioc.run();
+  for (auto &client : clients) {
+    client.join();
+  }
+
+  RunResult result;
+  result.serverThreads = serverThreads;
+  result.seconds = std::chrono::duration<double>(options.duration).count();
+  for (auto &connection : stats) {
+    result.requests += connection.requests;
+    result.errors += connection.errors;
+    result.bytes += connection.bytes;
+    result.latencies.insert(result.latencies.end(),
+                            connection.latencies.begin(),
+                            connection.latencies.end());
+  }
+  std::sort(result.latencies.begin(), result.latencies.end());
+  return result;
+}
+
+//------------------------------------------------------------------------------
+
+void printHeader(const Options &options) {
+  fmt::print("cms-bench: {} connections, {} client thread(s), {}, mix "
+             "hit={} miss={} static={} notfound={}\n",
+             options.connections, options.clientThreads,
+             options.rate > 0 ? fmt::format("open loop at {} req/s",
+                                            options.rate)
+                              : std::string("closed loop"),
+             options.mix[0], options.mix[1], options.mix[2], options.mix[3]);
+  fmt::print("{:>8} {:>10} {:>12} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} "
+             "{:>8}\n",
+             "threads", "requests", "req/s", "MB/s", "p50 ms", "p90 ms",
+             "p99 ms", "p99.9 ms", "max ms", "errors");
+}
+
+void printResult(const RunResult &result) {
+  fmt::print("{:>8} {:>10} {:>12.0f} {:>9.1f} {:>9.3f} {:>9.3f} {:>9.3f} "
+             "{:>9.3f} {:>9.3f} {:>8}\n",
+             result.serverThreads, result.requests, result.requestsPerSecond(),
+             result.megabytesPerSecond(), result.percentileMillis(0.5),
+             result.percentileMillis(0.9), result.percentileMillis(0.99),
+             result.percentileMillis(0.999), result.percentileMillis(1.0),
+             result.errors);
+  std::fflush(stdout);
+}
+
+void writeJson(const Options &options, const std::vector<RunResult> &results) {
+  std::string out = fmt::format(
+      "{{\"connections\":{},\"clientThreads\":{},\"rate\":{},"
+      "\"durationSeconds\":{},\"mix\":{{\"hit\":{},\"miss\":{},"
+      "\"static\":{},\"notfound\":{}}},\"runs\":[",
+      options.connections, options.clientThreads, options.rate,
+      std::chrono::duration<double>(options.duration).count(), options.mix[0],
+      options.mix[1], options.mix[2], options.mix[3]);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &result = results[i];
+    fmt::format_to(std::back_inserter(out),
+                   "{}{{\"serverThreads\":{},\"requests\":{},\"errors\":{},"
+                   "\"requestsPerSecond\":{:.1f},\"megabytesPerSecond\":{:.3f},"
+                   "\"p50Ms\":{:.3f},\"p90Ms\":{:.3f},\"p99Ms\":{:.3f},"
+                   "\"p999Ms\":{:.3f},\"maxMs\":{:.3f}}}",
+                   i == 0 ? "" : ",", result.serverThreads, result.requests,
+                   result.errors, result.requestsPerSecond(),
+                   result.megabytesPerSecond(), result.percentileMillis(0.5),
+                   result.percentileMillis(0.9), result.percentileMillis(0.99),
+                   result.percentileMillis(0.999),
+                   result.percentileMillis(1.0));
+  }
+  out.append("]}\n");
+  std::ofstream file(options.jsonPath, std::ios::binary);
+  file << out;
+}
+
+// "1,2,4" into {1, 2, 4}.
+std::vector<int> parseList(const std::string &text) {
+  std::vector<int> values;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    values.push_back(std::stoi(item));
+  }
+  return values;
+}
+
+// "hit=70,miss=10,static=10,notfound=10"; kinds left out weigh nothing.
+std::array<unsigned, 4> parseMix(const std::string &text) {
+  std::array<unsigned, 4> mix{};
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    auto equals = item.find('=');
+    auto name = std::string_view(item).substr(0, equals);
+    auto found = std::find(kRequestKindNames.begin(), kRequestKindNames.end(),
+                           name);
+    if (equals == std::string::npos || found == kRequestKindNames.end()) {
+      throw std::invalid_argument("unknown mix entry: " + item);
+    }
+    mix[found - kRequestKindNames.begin()] =
+        static_cast<unsigned>(std::stoul(item.substr(equals + 1)));
+  }
+  if (mix[0] + mix[1] + mix[2] + mix[3] == 0) {
+    throw std::invalid_argument("mix has no weight");
+  }
+  return mix;
+}
+
+} // namespace bench
+
+int main(int argc, char *argv[]) {
+  bench::Options options;
+  std::string threads = "1";
+  std::string mix = "hit=70,miss=10,static=10,notfound=10";
+  double durationSeconds = 5;
+  double warmupSeconds = 1;
+  std::string prepareDirectory;
+  try {
+    po::options_description desc("Allowed options");
+    desc.add_options()("help,h", "Produce help message")(
+        "target", po::value<std::string>(&options.target),
+        "host:port of a running server; default starts one in-process")(
+        "fixture", po::value<std::string>(&options.fixture),
+        "Content fixture for the in-process server")(
+        "threads", po::value<std::string>(&threads),
+        "Server IO thread counts to run, e.g. 1,2,4,8")(
+        "client-threads", po::value<int>(&options.clientThreads),
+        "Load generator threads")(
+        "connections,c", po::value<int>(&options.connections),
+        "Concurrent keep-alive connections")(
+        "rate,r", po::value<double>(&options.rate),
+        "Open loop: requests per second in total; default closed loop")(
+        "duration,d", po::value<double>(&durationSeconds),
+        "Seconds measured per run")(
+        "warmup", po::value<double>(&warmupSeconds),
+        "Seconds of load before measuring")(
+        "mix", po::value<std::string>(&mix),
+        "Request weights, e.g. hit=70,miss=10,static=10,notfound=10")(
+        "miss-posts", po::value<int>(&options.missPosts),
+        "Distinct posts requested by misses")(
+        "json", po::value<std::string>(&options.jsonPath),
+        "Also write the results as JSON to this file")(
+        "prepare-target", po::value<std::string>(&prepareDirectory),
+        "Write the fixture with the miss posts and the static file into "
+        "this directory for a --target server, then exit");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    options.serverThreads = bench::parseList(threads);
+    options.mix = bench::parseMix(mix);
+    options.duration = std::chrono::milliseconds(
+        static_cast<int64_t>(durationSeconds * 1000));
+    options.warmup = std::chrono::milliseconds(
+        static_cast<int64_t>(warmupSeconds * 1000));
+    options.clientThreads = std::max(1, options.clientThreads);
+    options.connections = std::max(1, options.connections);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!prepareDirectory.empty()) {
+    try {
+      bench::prepareTarget(options, prepareDirectory);
+    } catch (const std::exception &e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  // Request logging would measure the terminal rather than the server.
+  spdlog::set_level(spdlog::level::warn);
+
+  std::vector<bench::RunResult> results;
+  try {
+    bench::printHeader(options);
+    if (!options.target.empty()) {
+      auto colon = options.target.rfind(':');
+      if (colon == std::string::npos) {
+        throw std::invalid_argument("--target must be host:port");
+      }
+      net::io_context resolver_ioc;
+      tcp::resolver resolver(resolver_ioc);
+      auto endpoints = resolver.resolve(options.target.substr(0, colon),
+                                        options.target.substr(colon + 1));
+      auto result = bench::runLoad(options, endpoints.begin()->endpoint(),
+                                   options.target.substr(0, colon), 0);
+      bench::printResult(result);
+      results.push_back(std::move(result));
+    } else {
+      // Runs outlive any one server, so the Date clock gets its own loop.
+      net::io_context clock_ioc;
+      auto clock_work = net::make_work_guard(clock_ioc);
+      std::thread clock_thread([&clock_ioc] { clock_ioc.run(); });
+      services::HttpDateClock::instance().start(clock_ioc);
+
+      auto store = bench::makeStore(options);
+      auto docRoot = std::make_shared<std::string const>(
+          (std::filesystem::temp_directory_path() /
+           fmt::format("cms-bench-{}", ::getpid()))
+              .string());
+      std::filesystem::create_directories(*docRoot);
+      std::ofstream(*docRoot + std::string(bench::kStaticTarget))
+          << std::string(bench::kStaticFileSize, 'x');
+
+      for (int serverThreads : options.serverThreads) {
+        bench::InProcessServer server(store, docRoot,
+                                      std::max(1, serverThreads));
+        auto result = bench::runLoad(options, server.endpoint(), "localhost",
+                                     serverThreads);
+        bench::printResult(result);
+        results.push_back(std::move(result));
+      }
+
+      std::filesystem::remove_all(*docRoot);
+      clock_work.reset();
+      clock_ioc.stop();
+      clock_thread.join();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!options.jsonPath.empty()) {
+    bench::writeJson(options, results);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef CMS_MARKDOWN_BATCH_BENCH_HPP
+#define CMS_MARKDOWN_BATCH_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/markdownBatch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#ifndef CMS_CMARK_SAMPLES_DIR
+#define CMS_CMARK_SAMPLES_DIR "subprojects/cmark/bench/samples"
+#endif
+
+namespace bench {
+
+// cmark's benchmark samples, repeated into a batch of a few megabytes.
+const std::vector<std::string> &markdownSamples() {
+  static const std::vector<std::string> samples = [] {
+    std::vector<std::string> files;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(CMS_CMARK_SAMPLES_DIR)) {
+      if (entry.path().extension() == ".md") {
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::ostringstream text;
+        text << file.rdbuf();
+        files.push_back(text.str());
+      }
+    }
+    std::vector<std::string> batch;
+    for (int copy = 0; copy < 40 && !files.empty(); ++copy) {
+      batch.insert(batch.end(), files.begin(), files.end());
+    }
+    return batch;
+  }();
+  return samples;
+}
+
+// Batch throughput by worker count; compare MB/s across the thread args.
+void BM_MarkdownBatch(benchmark::State &state) {
+  const auto &samples = markdownSamples();
+  if (samples.empty()) {
+    state.SkipWithError("no samples in " CMS_CMARK_SAMPLES_DIR);
+    return;
+  }
+  std::vector<std::string_view> sources(samples.begin(), samples.end());
+  cms::MarkdownBatchRenderer renderer(static_cast<unsigned>(state.range(0)));
+  size_t bytes = 0;
+  for (auto _ : state) {
+    auto result = renderer.render(sources);
+    bytes = result.sourceBytes;
+    benchmark::DoNotOptimize(result.html.data());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["documents"] = static_cast<double>(sources.size());
+}
+BENCHMARK(BM_MarkdownBatch)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace bench
+
+#endif // CMS_MARKDOWN_BATCH_BENCH_HPP
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef CMS_METRICS_BENCH_HPP
+#define CMS_METRICS_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/metrics.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+// One atomic shared by every thread: what recording costs without shards.
+void BM_CounterSharedAtomic(benchmark::State &state) {
+  static std::atomic<uint64_t> counter{0};
+  for (auto _ : state) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+  benchmark::DoNotOptimize(counter.load());
+}
+BENCHMARK(BM_CounterSharedAtomic)->ThreadRange(1, 8);
+
+void BM_CounterSharded(benchmark::State &state) {
+  static services::Counter counter;
+  for (auto _ : state) {
+    counter.add();
+  }
+  benchmark::DoNotOptimize(counter.value());
+}
+BENCHMARK(BM_CounterSharded)->ThreadRange(1, 8);
+
+void BM_HistogramShared(benchmark::State &state) {
+  static services::LatencyHistogram histogram;
+  uint64_t micros = 1;
+  for (auto _ : state) {
+    histogram.record(micros);
+    micros = micros * 3 % 100003;
+  }
+}
+BENCHMARK(BM_HistogramShared)->ThreadRange(1, 8);
+
+void BM_HistogramSharded(benchmark::State &state) {
+  static services::ShardedHistogram histogram;
+  uint64_t micros = 1;
+  for (auto _ : state) {
+    histogram.record(micros);
+    micros = micros * 3 % 100003;
+  }
+}
+BENCHMARK(BM_HistogramSharded)->ThreadRange(1, 8);
+
+// Everything one HTTP request records: its route/status counter, latency
+// histogram, bytes in and out, including reading the clock.
+void BM_RequestMetricsRecord(benchmark::State &state) {
+  static services::Counter requests;
+  static services::ShardedHistogram latency;
+  static services::Counter bytesIn;
+  static services::Counter bytesOut;
+  auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    requests.add();
+    latency.record(std::chrono::steady_clock::now() - start);
+    bytesIn.add(420);
+    bytesOut.add(16384);
+  }
+}
+BENCHMARK(BM_RequestMetricsRecord)->ThreadRange(1, 8);
+
+// What a scrape pays to sum the shards of one histogram.
+void BM_HistogramShardedSnapshot(benchmark::State &state) {
+  services::ShardedHistogram histogram;
+  histogram.record(100);
+  for (auto _ : state) {
+    auto snapshot = histogram.snapshot();
+    benchmark::DoNotOptimize(snapshot);
+  }
+}
+BENCHMARK(BM_HistogramShardedSnapshot);
+
+} // namespace bench
+
+#endif // CMS_METRICS_BENCH_HPP
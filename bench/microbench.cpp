@@ -0,0 +1,22 @@
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+
+// Header-only sources, so every benchmark lives in this one translation unit.
+#include "allocationCounter.hpp"
+#include "dateBench.hpp"
+#include "htmlEscapeBench.hpp"
+#include "httpRoutingBench.hpp"
+#include "keyValueCacheBench.hpp"
+#include "layoutTemplateBench.hpp"
+#include "markdownBatchBench.hpp"
+#include "metricsBench.hpp"
+#include "renderArenaBench.hpp"
+#include "seedContentBench.hpp"
+#include "stringReplacerBench.hpp"
+
+#include <benchmark/benchmark.h>
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+#pragma once
+
+#ifndef CMS_RENDER_ARENA_BENCH_HPP
+#define CMS_RENDER_ARENA_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "allocationCounter.hpp"
+#include "include/markdown.hpp"
+#include "include/renderArena.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+#include <cmark.h>
+
+namespace bench {
+
+// A post-like markdown source of roughly the given size.
+std::string makeMarkdown(size_t size) {
+  constexpr std::string_view kSection =
+      "## Section heading\n\n"
+      "Some *emphasis*, some **strong** text and a [link](/posts/3) in a "
+      "paragraph that wraps\nacross lines, with `inline code` too.\n\n"
+      "- first item\n- second item with _emphasis_\n- third item\n\n"
+      "```cpp\nint main() { return 0; }\n```\n\n"
+      "> A quoted line.\n\n";
+  std::string markdown;
+  markdown.reserve(size + kSection.size());
+  while (markdown.size() < size) {
+    markdown.append(kSection);
+  }
+  return markdown;
+}
+
+// cmark's default allocator, counting its calls: cmark mallocs directly, so
+// the global operator new does not see them.
+std::atomic<size_t> cmarkAllocations{0};
+
+void *countingCalloc(size_t count, size_t size) {
+  cmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+  return cmark_get_default_mem_allocator()->calloc(count, size);
+}
+
+void *countingRealloc(void *pointer, size_t size) {
+  cmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+  return cmark_get_default_mem_allocator()->realloc(pointer, size);
+}
+
+void countingFree(void *pointer) { std::free(pointer); }
+
+cmark_mem countingMem{countingCalloc, countingRealloc, countingFree};
+
+constexpr std::string_view kHeading = "<h1>Hello World</h1><h4>Mon, January "
+                                      "01, 2024 at 12:00 AM UTC</h4>";
+
+// The body as composed before the arena: heap string appends plus
+// cmark_markdown_to_html, which uses the default allocator.
+void BM_MarkdownBodyHeap(benchmark::State &state) {
+  auto markdown = makeMarkdown(static_cast<size_t>(state.range(0)));
+  cmarkAllocations = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    std::string body;
+    body.append(kHeading);
+    cmark_parser *parser =
+        cmark_parser_new_with_mem(cms::kMarkdownOptions, &countingMem);
+    cmark_parser_feed(parser, markdown.data(), markdown.size());
+    cmark_node *document = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    char *html = cmark_render_html(document, cms::kMarkdownOptions);
+    cmark_node_free(document);
+    body.append(html);
+    std::free(html);
+    benchmark::DoNotOptimize(body);
+  }
+  allocations.report(state, cmarkAllocations.load());
+  state.SetBytesProcessed(state.iterations() * markdown.size());
+}
+BENCHMARK(BM_MarkdownBodyHeap)->Range(4 << 10, 256 << 10);
+
+// The body as Content::composePage builds it now, in the thread's arena.
+void BM_MarkdownBodyArena(benchmark::State &state) {
+  auto markdown = makeMarkdown(static_cast<size_t>(state.range(0)));
+  { cms::RenderArena::Scope warmup; } // first use allocates the buffer
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    cms::RenderArena::Scope arena;
+    std::pmr::string body(arena.resource());
+    body.reserve(kHeading.size() + markdown.size() * 5 / 4);
+    body.append(kHeading);
+    cms::appendMarkdownHtml(markdown, body);
+    benchmark::DoNotOptimize(body);
+  }
+  allocations.report(state);
+  state.SetBytesProcessed(state.iterations() * markdown.size());
+}
+BENCHMARK(BM_MarkdownBodyArena)->Range(4 << 10, 256 << 10);
+
+} // namespace bench
+
+#endif // CMS_RENDER_ARENA_BENCH_HPP
@@ -0,0 +1,420 @@
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/trafficCapture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/program_options.hpp>
+#include <fmt/format.h>
+
+/***
+###############################################################################
+# Namespaces
+###############################################################################
+***/
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace po = boost::program_options;
+using tcp = boost::asio::ip::tcp;
+
+/**
+ * cms-replay: re-issues a traffic capture (CMS_TRAFFIC_CAPTURE) against a
+ * running server. Every captured connection gets its own client connection
+ * that sends the same requests in the same order, each when it arrived in
+ * the capture divided by --speed, so the original concurrency and pacing
+ * are kept; --speed 0 sends each connection's requests back to back.
+ * Latency is measured from when a request was due, so a server that falls
+ * behind the schedule shows it. Status codes are compared with the
+ * captured ones; body hashes with those saved by an earlier replay.
+ */
+namespace replay {
+
+struct Options {
+  std::string capture;
+  std::string target;
+  double speed = 1.0; // 0 for as fast as the server answers
+  int clientThreads = 1;
+  size_t limit = 0; // requests to replay, 0 for all
+  std::string saveHashes;
+  std::string compareHashes;
+  std::string jsonPath;
+};
+
+// What the server answered to one captured request.
+struct Answer {
+  unsigned status = 0; // 0 when the connection failed
+  uint64_t bodyHash = 0;
+  uint32_t latencyMicros = 0;
+};
+
+uint64_t bodyHash(std::string_view body) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char byte : body) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// State shared by the connections of a replay.
+struct ReplayRun {
+  const Options &options;
+  const std::vector<services::CapturedRequest> &requests;
+  std::vector<Answer> &answers;
+  tcp::endpoint endpoint;
+  std::chrono::steady_clock::time_point start;
+};
+
+// One captured connection: its requests in order, sent one at a time.
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+  Connection(net::io_context &ioc, ReplayRun &run, std::vector<size_t> indices)
+      : stream(net::make_strand(ioc)), timer(stream.get_executor()), run(run),
+        indices(std::move(indices)) {}
+
+  void start() { next(); }
+
+private:
+  std::chrono::steady_clock::time_point due_at(size_t index) const {
+    if (run.options.speed <= 0) {
+      return std::chrono::steady_clock::now();
+    }
+    auto offset = std::chrono::duration<double, std::micro>(
+        run.requests[index].arrivalMicros / run.options.speed);
+    return run.start +
+           std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+               offset);
+  }
+
+  void next() {
+    if (position == indices.size()) {
+      beast::error_code ignored;
+      stream.socket().shutdown(tcp::socket::shutdown_both, ignored);
+      return;
+    }
+    due = due_at(indices[position]);
+    timer.expires_at(due);
+    timer.async_wait([self = shared_from_this()](beast::error_code ec) {
+      if (!ec) {
+        self->connected ? self->send() : self->connect();
+      }
+    });
+  }
+
+  void connect() {
+    buffer.clear();
+    stream.async_connect(run.endpoint, [self = shared_from_this()](
+                                           beast::error_code ec) {
+      if (ec) {
+        return self->failed();
+      }
+      self->connected = true;
+      self->send();
+    });
+  }
+
+  void send() {
+    const auto &captured = run.requests[indices[position]];
+    request = {};
+    request.version(captured.version);
+    request.method_string(captured.method);
+    request.target(captured.target);
+    for (const auto &[name, value] : captured.headers) {
+      request.set(name, value);
+    }
+    request.keep_alive(true);
+    http::async_write(stream, request,
+                      beast::bind_front_handler(&Connection::on_write,
+                                                shared_from_this()));
+  }
+
+  void on_write(beast::error_code ec, std::size_t) {
+    if (ec) {
+      return failed();
+    }
+    response.emplace();
+    response->body_limit(64 << 20);
+    if (request.method() == http::verb::head) {
+      response->skip(true);
+    }
+    http::async_read(stream, buffer, *response,
+                     beast::bind_front_handler(&Connection::on_read,
+                                               shared_from_this()));
+  }
+
+  void on_read(beast::error_code ec, std::size_t) {
+    if (ec) {
+      return failed();
+    }
+    auto &answer = run.answers[indices[position]];
+    const auto &message = response->get();
+    answer.status = message.result_int();
+    answer.bodyHash = bodyHash(message.body());
+    answer.latencyMicros = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - due)
+            .count());
+    if (!message.keep_alive()) {
+      close();
+    }
+    response.reset();
+    ++position;
+    next();
+  }
+
+  // The request is left unanswered; later ones go on a new connection.
+  void failed() {
+    close();
+    ++position;
+    next();
+  }
+
+  void close() {
+    beast::error_code ignored;
+    stream.socket().close(ignored);
+    connected = false;
+  }
+
+  beast::tcp_stream stream;
+  net::steady_timer timer;
+  beast::flat_buffer buffer;
+  http::request<http::empty_body> request;
+  std::optional<http::response_parser<http::string_body>> response;
+  ReplayRun &run;
+  std::vector<size_t> indices;
+  size_t position = 0;
+  bool connected = false;
+  std::chrono::steady_clock::time_point due;
+};
+
+double percentileMillis(const std::vector<uint32_t> &sorted,
+                        double quantile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = std::min(sorted.size() - 1,
+                          static_cast<size_t>(quantile * sorted.size()));
+  return sorted[index] / 1000.0;
+}
+
+// Lines of "index status hash" from an earlier replay.
+std::map<size_t, Answer> loadHashes(const std::string &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to open body hashes: " + path);
+  }
+  std::map<size_t, Answer> hashes;
+  size_t index;
+  Answer answer;
+  while (file >> index >> answer.status >> std::hex >> answer.bodyHash >>
+         std::dec) {
+    hashes[index] = answer;
+  }
+  return hashes;
+}
+
+void saveHashes(const std::string &path, const std::vector<Answer> &answers) {
+  std::ofstream file(path);
+  for (size_t i = 0; i < answers.size(); ++i) {
+    if (answers[i].status != 0) {
+      file << fmt::format("{} {} {:016x}\n", i, answers[i].status,
+                          answers[i].bodyHash);
+    }
+  }
+}
+
+int run(const Options &options) {
+  auto capture = services::readTrafficCapture(options.capture);
+  auto &requests = capture.requests;
+  // Records are written as requests complete; replay and --limit go by
+  // arrival. Stable, so a connection keeps its own request order.
+  std::stable_sort(requests.begin(), requests.end(),
+                   [](const auto &left, const auto &right) {
+                     return left.arrivalMicros < right.arrivalMicros;
+                   });
+  if (options.limit > 0 && requests.size() > options.limit) {
+    requests.resize(options.limit);
+  }
+  if (requests.empty()) {
+    throw std::runtime_error("no requests in " + options.capture);
+  }
+
+  // The captured connections, each with its requests in arrival order.
+  std::map<uint64_t, std::vector<size_t>> connections;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    connections[requests[i].connection].push_back(i);
+  }
+
+  auto colon = options.target.rfind(':');
+  if (colon == std::string::npos) {
+    throw std::invalid_argument("--target must be host:port");
+  }
+  net::io_context ioc(options.clientThreads);
+  tcp::resolver resolver(ioc);
+  auto endpoint = resolver
+                      .resolve(options.target.substr(0, colon),
+                               options.target.substr(colon + 1))
+                      .begin()
+                      ->endpoint();
+
+  std::vector<Answer> answers(requests.size());
+  ReplayRun replay{options, requests, answers, endpoint,
+                   std::chrono::steady_clock::now()};
+  for (auto &[id, indices] : connections) {
+    std::make_shared<Connection>(ioc, replay, std::move(indices))->start();
+  }
+  std::vector<std::thread> clients;
+  for (int i = 1; i < options.clientThreads; ++i) {
+    clients.emplace_back([&ioc] { ioc.run(); });
+  }
+  ioc.run();
+  for (auto &client : clients) {
+    client.join();
+  }
+  double wallSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - replay.start)
+                           .count();
+
+  std::optional<std::map<size_t, Answer>> baseline;
+  if (!options.compareHashes.empty()) {
+    baseline = loadHashes(options.compareHashes);
+  }
+  std::vector<uint32_t> latencies;
+  size_t failed = 0;
+  size_t statusMismatches = 0;
+  size_t bodyMismatches = 0;
+  size_t reported = 0;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto &answer = answers[i];
+    if (answer.status == 0) {
+      ++failed;
+      continue;
+    }
+    latencies.push_back(answer.latencyMicros);
+    std::string mismatch;
+    if (answer.status != requests[i].status) {
+      ++statusMismatches;
+      mismatch = fmt::format("status {}, captured {}", answer.status,
+                             requests[i].status);
+    } else if (baseline) {
+      auto found = baseline->find(i);
+      if (found != baseline->end() &&
+          found->second.bodyHash != answer.bodyHash) {
+        ++bodyMismatches;
+        mismatch = fmt::format("body hash {:016x}, saved {:016x}",
+                               answer.bodyHash, found->second.bodyHash);
+      }
+    }
+    if (!mismatch.empty() && reported++ < 10) {
+      fmt::print("mismatch #{} {} {}: {}\n", i, requests[i].method,
+                 requests[i].target, mismatch);
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  double capturedSeconds = requests.back().arrivalMicros / 1e6; // sorted
+  fmt::print("cms-replay: {} requests on {} connections, {:.1f}s captured, "
+             "speed {}\n",
+             requests.size(), connections.size(), capturedSeconds,
+             options.speed > 0 ? fmt::format("{}x", options.speed)
+                               : std::string("max"));
+  fmt::print("{:>10} {:>8} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} "
+             "{:>8} {:>8}\n",
+             "requests", "failed", "req/s", "p50 ms", "p90 ms", "p99 ms",
+             "p99.9 ms", "max ms", "wall s", "status!=", "body!=");
+  fmt::print("{:>10} {:>8} {:>10.0f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f} "
+             "{:>9.3f} {:>9.1f} {:>8} {:>8}\n",
+             latencies.size(), failed, latencies.size() / wallSeconds,
+             percentileMillis(latencies, 0.5),
+             percentileMillis(latencies, 0.9),
+             percentileMillis(latencies, 0.99),
+             percentileMillis(latencies, 0.999),
+             percentileMillis(latencies, 1.0), wallSeconds, statusMismatches,
+             bodyMismatches);
+
+  if (!options.saveHashes.empty()) {
+    saveHashes(options.saveHashes, answers);
+  }
+  if (!options.jsonPath.empty()) {
+    std::ofstream file(options.jsonPath, std::ios::binary);
+    file << fmt::format(
+        "{{\"requests\":{},\"connections\":{},\"speed\":{},\"failed\":{},"
+        "\"statusMismatches\":{},\"bodyMismatches\":{},\"wallSeconds\":{:.3f},"
+        "\"requestsPerSecond\":{:.1f},\"p50Ms\":{:.3f},\"p90Ms\":{:.3f},"
+        "\"p99Ms\":{:.3f},\"p999Ms\":{:.3f},\"maxMs\":{:.3f}}}\n",
+        requests.size(), connections.size(), options.speed, failed,
+        statusMismatches, bodyMismatches, wallSeconds,
+        latencies.size() / wallSeconds, percentileMillis(latencies, 0.5),
+        percentileMillis(latencies, 0.9), percentileMillis(latencies, 0.99),
+        percentileMillis(latencies, 0.999), percentileMillis(latencies, 1.0));
+  }
+  return failed + statusMismatches + bodyMismatches == 0 ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE;
+}
+
+} // namespace replay
+
+int main(int argc, char *argv[]) {
+  replay::Options options;
+  try {
+    po::options_description desc("Allowed options");
+    desc.add_options()("help,h", "Produce help message")(
+        "capture", po::value<std::string>(&options.capture)->required(),
+        "Capture file written with CMS_TRAFFIC_CAPTURE")(
+        "target", po::value<std::string>(&options.target)->required(),
+        "host:port of the server to replay against")(
+        "speed,s", po::value<double>(&options.speed),
+        "1 for the captured pace, N for N times faster, 0 for max speed")(
+        "client-threads", po::value<int>(&options.clientThreads),
+        "Replay threads")("limit", po::value<size_t>(&options.limit),
+                          "Replay only the first N requests")(
+        "save-hashes", po::value<std::string>(&options.saveHashes),
+        "Write the status and body hash of every response to this file")(
+        "compare-hashes", po::value<std::string>(&options.compareHashes),
+        "Compare body hashes with a file from --save-hashes")(
+        "json", po::value<std::string>(&options.jsonPath),
+        "Also write the results as JSON to this file");
+
+    po::positional_options_description positional;
+    positional.add("capture", 1);
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv)
+                  .options(desc)
+                  .positional(positional)
+                  .run(),
+              vm);
+    if (vm.count("help")) {
+      std::cout << "Usage: cms-replay CAPTURE --target host:port [options]\n"
+                << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+    options.clientThreads = std::max(1, options.clientThreads);
+    return replay::run(options);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef CMS_SEED_CONTENT_BENCH_HPP
+#define CMS_SEED_CONTENT_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/markdown.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <bsoncxx/json.hpp>
+#include <cmark.h>
+
+#ifndef CMS_BENCH_FIXTURE
+#define CMS_BENCH_FIXTURE "resources/database/fixture.json"
+#endif
+
+namespace bench {
+
+// Markdown content of the posts in the content fixture, which are the seed
+// posts the development database starts with.
+const std::vector<std::string> &seedPosts() {
+  static const std::vector<std::string> posts = [] {
+    std::vector<std::string> sources;
+    std::ifstream file(CMS_BENCH_FIXTURE, std::ios::binary);
+    if (!file.is_open()) {
+      return sources;
+    }
+    std::stringstream json;
+    json << file.rdbuf();
+    auto fixture = bsoncxx::from_json(json.str());
+    for (const auto &database : fixture.view()) {
+      if (database.type() != bsoncxx::type::k_document) {
+        continue;
+      }
+      auto collection = database.get_document().value["posts"];
+      if (!collection || collection.type() != bsoncxx::type::k_array) {
+        continue;
+      }
+      for (const auto &post : collection.get_array().value) {
+        auto content = post["content"];
+        if (content && content.type() == bsoncxx::type::k_string) {
+          auto text = content.get_string().value;
+          sources.emplace_back(text.data(), text.size());
+        }
+      }
+    }
+    return sources;
+  }();
+  return posts;
+}
+
+// cmark's one-call API on each seed post.
+void BM_CmarkSeedPosts(benchmark::State &state) {
+  const auto &posts = seedPosts();
+  if (posts.empty()) {
+    state.SkipWithError("no posts in " CMS_BENCH_FIXTURE);
+    return;
+  }
+  size_t bytes = 0;
+  for (const auto &post : posts) {
+    bytes += post.size();
+  }
+  for (auto _ : state) {
+    for (const auto &post : posts) {
+      char *html = cmark_markdown_to_html(post.data(), post.size(),
+                                          cms::kMarkdownOptions);
+      benchmark::DoNotOptimize(html);
+      std::free(html);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["posts"] = static_cast<double>(posts.size());
+}
+BENCHMARK(BM_CmarkSeedPosts);
+
+// The same posts through the path the server renders with.
+void BM_MarkdownSeedPosts(benchmark::State &state) {
+  const auto &posts = seedPosts();
+  if (posts.empty()) {
+    state.SkipWithError("no posts in " CMS_BENCH_FIXTURE);
+    return;
+  }
+  size_t bytes = 0;
+  for (const auto &post : posts) {
+    bytes += post.size();
+  }
+  std::string html;
+  for (auto _ : state) {
+    for (const auto &post : posts) {
+      html.clear();
+      cms::appendMarkdownHtml(post, html);
+      benchmark::DoNotOptimize(html.data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_MarkdownSeedPosts);
+
+} // namespace bench
+
+#endif // CMS_SEED_CONTENT_BENCH_HPP
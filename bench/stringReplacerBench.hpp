@@ -0,0 +1,156 @@
+#pragma once
+
+#ifndef CMS_STRING_REPLACER_BENCH_HPP
+#define CMS_STRING_REPLACER_BENCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "include/stringUtil.hpp"
+#include "layoutTemplateBench.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+const std::vector<std::pair<std::string, std::string>> kPlaceholders{
+    {"%REPLACE_WITH_TITLE_ID%", "Hello World"},
+    {"%REPLACE_WITH_DESCRIPTION%", "A post about nothing in particular"},
+    {"%REPLACE_WITH_CANONICAL_PATH%", "/posts/3"},
+    {"%REPLACE_WITH_DATE%", "Mon, January 01, 2024 at 12:00 AM UTC"},
+};
+
+// An assembled page of the given size with every placeholder in its head
+// and a few more in the body, the way a layout-heavy tenant page looks.
+std::string makePlaceholderPage(size_t size) {
+  std::string page(kLayoutHeader);
+  page.append("<link rel=\"canonical\" href=\"%REPLACE_WITH_CANONICAL_PATH%\">"
+              "<meta name=\"description\" "
+              "content=\"%REPLACE_WITH_DESCRIPTION%\">");
+  auto body = makeBody(size);
+  size_t quarter = body.size() / 4;
+  for (size_t i = 0; i < 4; ++i) {
+    page.append(body, i * quarter, quarter);
+    page.append(kPlaceholders[i].first);
+  }
+  page.append(kLayoutFooter);
+  return page;
+}
+
+// The single-needle replacer, run once per placeholder.
+void BM_StringReplacerPerNeedle(benchmark::State &state) {
+  auto page = makePlaceholderPage(static_cast<size_t>(state.range(0)));
+  std::vector<string_util::StringReplacer> replacers;
+  for (const auto &[needle, replacement] : kPlaceholders) {
+    replacers.emplace_back(needle, replacement);
+  }
+  for (auto _ : state) {
+    std::string result = page;
+    for (const auto &replacer : replacers) {
+      result = replacer.replace(result);
+    }
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * page.size());
+}
+BENCHMARK(BM_StringReplacerPerNeedle)
+    ->RangeMultiplier(2)
+    ->Range(4 << 10, 512 << 10);
+
+// Needle by needle at every position, longest first, for comparison.
+std::string
+scalarReplace(std::string_view input,
+              std::vector<std::pair<std::string, std::string>> replacements) {
+  std::stable_sort(replacements.begin(), replacements.end(),
+                   [](const auto &left, const auto &right) {
+                     return left.first.size() > right.first.size();
+                   });
+  std::string result;
+  for (size_t pos = 0; pos < input.size();) {
+    auto match = std::find_if(
+        replacements.begin(), replacements.end(), [&](const auto &pair) {
+          return input.substr(pos).starts_with(pair.first);
+        });
+    if (match == replacements.end()) {
+      result.push_back(input[pos++]);
+    } else {
+      result.append(match->second);
+      pos += match->first.size();
+    }
+  }
+  return result;
+}
+
+// An input MultiStringReplacer replaces differently from scalarReplace, or
+// none. Needle sets take each of its search paths: one first byte
+// (memchr), four (vector) and six (table). Every length up to three AVX2
+// vectors is tried with each needle at each offset, cut short where it
+// runs past the end, in text with stray first bytes that match nothing.
+std::optional<std::string> multiStringReplacerMismatch() {
+  const std::vector<std::pair<std::string, std::string>> kOneFirstByte{
+      {"%A%", "alpha"}, {"%AB%", ""}, {"%B%", "b"}};
+  std::vector<std::pair<std::string, std::string>> kVector{
+      {"%A%", "alpha"}, {"<b>", "**"}, {"&amp;", "&"}, {"{{", "("}};
+  auto kTable = kVector;
+  kTable.insert(kTable.end(), {{"[x]", "y"}, {"#h", "H"}});
+  constexpr std::string_view kFiller = "lorem %A ipsum <i> &am x{ #[ ";
+
+  for (const auto &set : {kOneFirstByte, kVector, kTable}) {
+    string_util::MultiStringReplacer replacer(set);
+    for (size_t size = 0; size <= 96; ++size) {
+      std::string clean;
+      while (clean.size() < size) {
+        clean.append(kFiller);
+      }
+      clean.resize(size);
+      if (replacer.replace(clean) != scalarReplace(clean, set)) {
+        return clean;
+      }
+      for (const auto &[needle, replacement] : set) {
+        for (size_t at = 0; at < size; ++at) {
+          auto text = clean;
+          text.replace(at, needle.size(), needle);
+          text.resize(size);
+          if (replacer.replace(text) != scalarReplace(text, set)) {
+            return text;
+          }
+        }
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+void BM_MultiStringReplacer(benchmark::State &state) {
+  static const auto mismatch = multiStringReplacerMismatch();
+  if (mismatch) {
+    state.SkipWithError(
+        ("MultiStringReplacer differs from scalarReplace on \"" + *mismatch +
+         "\"")
+            .c_str());
+    return;
+  }
+  auto page = makePlaceholderPage(static_cast<size_t>(state.range(0)));
+  string_util::MultiStringReplacer replacer(kPlaceholders);
+  for (auto _ : state) {
+    auto result = replacer.replace(page);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * page.size());
+}
+BENCHMARK(BM_MultiStringReplacer)
+    ->RangeMultiplier(2)
+    ->Range(4 << 10, 512 << 10);
+
+} // namespace bench
+
+#endif // CMS_STRING_REPLACER_BENCH_HPP
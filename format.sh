@@ -21,4 +21,4 @@
 
 set -euo pipefail
 
-find src -type f \( -name "*.cpp" -o -name "*.h" -o -name "*.hpp" -o -name "*.c" -o -name "*.cc" -o -name "*.cxx" \) -exec clang-format -i {} \+
+find src bench -type f \( -name "*.cpp" -o -name "*.h" -o -name "*.hpp" -o -name "*.c" -o -name "*.cc" -o -name "*.cxx" \) -exec clang-format -i {} \+
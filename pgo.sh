@@ -0,0 +1,160 @@
+#!/usr/bin/env bash
+# -*- mode: shell-script; indent-tabs-mode: nil; sh-basic-offset: 4; -*-
+# ex: ts=8 sw=4 sts=4 et filetype=sh
+#
+#  pgo.sh
+#
+#  Copyright © 2010 — 2025 Randolph Ledesma
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Profile-guided build of the server with GCC or Clang (whichever CXX
+# selects), optionally followed by BOLT:
+#   1. build with -Dpgo=off and measure the baseline
+#   2. build with -Dpgo=generate and train it: cms serves the fixture, with
+#      cms-bench's miss posts and static file, from the memory store, and
+#      cms-bench drives it with page cache hits, misses that render
+#      markdown, static files and not-found requests, then stops it with
+#      SIGTERM so the profile is written
+#   3. rebuild with -Dpgo=use and measure again
+#   4. with BOLT=1, instrument the PGO binary with llvm-bolt, train it the
+#      same way, write build/cms.bolt and measure that
+# Each build is measured the same way with cms-bench --target, using one
+# copy of cms-bench built in step 1, so the load generator is the same
+# unoptimized binary for every row. The throughput and latency deltas
+# against the baseline are printed.
+#
+# usage: [BOLT=1] [TRAIN_SECONDS=30] [MEASURE_SECONDS=20] ./pgo.sh [BUILD_DIR]
+
+set -euo pipefail
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+BUILD=$(realpath -m "${1:-$ROOT/build-pgo}")
+TRAIN_SECONDS=${TRAIN_SECONDS:-30}
+MEASURE_SECONDS=${MEASURE_SECONDS:-20}
+BOLT=${BOLT:-0}
+TARGET=127.0.0.1:10000
+ADMIN=127.0.0.1:10001
+MIX=hit=50,miss=30,static=10,notfound=10
+WORK="$BUILD/pgo-work"
+BENCH="$WORK/cms-bench"
+CONTENT="$WORK/content"
+SERVER_PID=
+
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+        SERVER_PID=
+    fi
+}
+trap stop_server EXIT
+
+# configure PGO TARGETS...: reconfigure with -Dpgo=PGO and build TARGETS
+configure() {
+    local options=(-Dbenchmarks=true -Dpgo="$1")
+    shift
+    if [ "$BOLT" = 1 ]; then
+        options+=(-Dbolt=true -Dstrip=false)
+    fi
+    if [ -f "$BUILD/build.ninja" ]; then
+        meson configure "$BUILD" "${options[@]}"
+    else
+        meson setup "$BUILD" "$ROOT" "${options[@]}"
+    fi
+    meson compile -C "$BUILD" "$@"
+}
+
+start_server() {
+    CMS_CONTENT_STORE="memory:$CONTENT/fixture.json" DOC_ROOT="$CONTENT" \
+        "$1" >>"$WORK/server.log" 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 100); do
+        if curl -sf -o /dev/null "http://$ADMIN/_cms/metrics"; then
+            return
+        fi
+        sleep 0.1
+    done
+    echo "server $1 did not start, see $WORK/server.log" >&2
+    exit 1
+}
+
+# train BINARY: serve the training mix, then exit cleanly
+train() {
+    start_server "$1"
+    "$BENCH" --target "$TARGET" --mix "$MIX" \
+        --duration "$TRAIN_SECONDS" --warmup 0 >>"$WORK/train.log"
+    stop_server
+}
+
+# measure NAME BINARY: closed-loop throughput with the same mix
+measure() {
+    start_server "$2"
+    "$BENCH" --target "$TARGET" --mix "$MIX" \
+        --duration "$MEASURE_SECONDS" --json "$WORK/$1.json" >/dev/null
+    stop_server
+}
+
+# field NAME KEY: a number from a cms-bench JSON result
+field() {
+    sed -E "s/.*\"$2\":([0-9.]+).*/\1/" "$WORK/$1.json"
+}
+
+mkdir -p "$WORK"
+: >"$WORK/server.log"
+: >"$WORK/train.log"
+
+echo "== baseline"
+configure off cms cms-bench
+cp "$BUILD/cms-bench" "$BENCH"
+"$BENCH" --prepare-target "$CONTENT"
+measure baseline "$BUILD/cms"
+
+echo "== instrumented build and training"
+rm -rf "$BUILD/pgo"
+configure generate cms
+train "$BUILD/cms"
+if compgen -G "$BUILD/pgo/*.profraw" >/dev/null; then
+    # Clang writes raw profiles; GCC's .gcda files are used as they are
+    llvm-profdata merge -output="$BUILD/pgo/cms.profdata" "$BUILD"/pgo/*.profraw
+fi
+
+echo "== optimized build"
+configure use cms
+measure pgo "$BUILD/cms"
+results=(baseline pgo)
+
+if [ "$BOLT" = 1 ]; then
+    echo "== bolt"
+    rm -f "$WORK/bolt.fdata"
+    llvm-bolt "$BUILD/cms" -instrument -o "$WORK/cms.instrumented" \
+        -instrumentation-file="$WORK/bolt.fdata"
+    train "$WORK/cms.instrumented"
+    llvm-bolt "$BUILD/cms" -o "$BUILD/cms.bolt" -data="$WORK/bolt.fdata" \
+        -reorder-blocks=ext-tsp -reorder-functions=hfsort+ \
+        -split-functions -split-all-cold -dyno-stats >>"$WORK/bolt.log"
+    measure bolt "$BUILD/cms.bolt"
+    results+=(bolt)
+fi
+
+base=$(field baseline requestsPerSecond)
+printf "\n%-10s %12s %9s %9s %9s\n" build "req/s" delta "p50 ms" "p99 ms"
+for name in "${results[@]}"; do
+    awk -v name="$name" -v rps="$(field "$name" requestsPerSecond)" \
+        -v base="$base" -v p50="$(field "$name" p50Ms)" \
+        -v p99="$(field "$name" p99Ms)" \
+        'BEGIN {
+            printf "%-10s %12.0f %+8.1f%% %9.3f %9.3f\n", name, rps,
+                (rps / base - 1) * 100, p50, p99
+        }'
+done
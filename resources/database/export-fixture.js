@@ -0,0 +1,52 @@
+// Build the memory content store fixture from the mongosh seed scripts.
+//
+// Usage: node resources/database/export-fixture.js > resources/database/fixture.json
+// Serve it with CMS_CONTENT_STORE=memory:resources/database/fixture.json
+const fs = require("fs");
+const path = require("path");
+const vm = require("vm");
+
+const databases = {};
+
+function collection(dbName, name) {
+  const collections = (databases[dbName] = databases[dbName] || {});
+  const documents = (collections[name] = collections[name] || []);
+  return {
+    createIndex() {},
+    insertMany(items) {
+      documents.push(...items);
+    },
+    deleteOne(filter) {
+      const index = documents.findIndex((item) => item.id === filter.id);
+      if (index >= 0) {
+        documents.splice(index, 1);
+      }
+    },
+  };
+}
+
+function database(dbName) {
+  return new Proxy(
+    {
+      getSiblingDB: (name) => database(name),
+      createCollection() {},
+    },
+    {
+      get(target, property) {
+        return property in target ? target[property] : collection(dbName, property);
+      },
+    },
+  );
+}
+
+for (const script of ["seed.js", "quizbin.js", "update-quizbin-layout.js"]) {
+  const context = {
+    db: database("test"),
+    ISODate: function (value) {
+      return { $date: new Date(value).toISOString() };
+    },
+  };
+  vm.runInNewContext(fs.readFileSync(path.join(__dirname, script), "utf8"), context);
+}
+
+process.stdout.write(JSON.stringify(databases, null, 2) + "\n");
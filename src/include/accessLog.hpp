@@ -0,0 +1,413 @@
+#pragma once
+
+#ifndef CMS_ACCESS_LOG_HPP
+#define CMS_ACCESS_LOG_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+namespace services {
+
+// One request as the access log keeps it until the writer formats it.
+struct AccessLogEntry {
+  static constexpr size_t kRemoteSize = 48; // fits an IPv6 address
+  static constexpr size_t kTargetSize = 128;
+
+  int64_t unixMillis = 0;
+  uint64_t bytesSent = 0;
+  uint32_t durationMicros = 0;
+  uint16_t status = 0;
+  uint8_t versionMajor = 1;
+  uint8_t versionMinor = 1;
+  std::string_view method; // beast's verb strings, which never go away
+  uint8_t remoteSize = 0;
+  uint16_t targetSize = 0;
+  std::array<char, kRemoteSize> remote;
+  std::array<char, kTargetSize> target;
+};
+
+/**
+ * Access log written off the IO threads. Each thread that records gets its
+ * own single-producer ring, so recording is a copy into the ring and two
+ * atomic operations, never a lock or a syscall; a full ring drops the entry
+ * and counts it rather than wait. A background writer drains every ring a
+ * few times a second, formats the lines (common log format followed by the
+ * response time in microseconds) and hands each batch to one writev. The
+ * file is rotated by size and age.
+ */
+class AccessLog {
+public:
+  struct Options {
+    std::string path;
+    double sampleRate = 1.0; // of requests answered without a server error
+    uint64_t maxBytes = 100ull << 20;
+    std::chrono::seconds maxAge{std::chrono::hours(24)};
+    size_t ringCapacity = 1024; // entries per thread, a power of two
+    std::chrono::milliseconds flushInterval{200};
+  };
+
+  static AccessLog &instance();
+
+  ~AccessLog();
+
+  // Open the log file and start the writer; call before serving.
+  bool open(Options configured);
+
+  // Write out what is queued and stop the writer.
+  void close();
+
+  bool enabled() const { return running.load(std::memory_order_relaxed); }
+
+  void record(std::string_view remote, std::string_view method,
+              std::string_view target, unsigned version, unsigned status,
+              uint64_t bytesSent, std::chrono::steady_clock::duration elapsed);
+
+  // Lines written and dropped, in Prometheus text format.
+  void writeMetrics(std::string &out) const;
+
+private:
+  struct Ring {
+    explicit Ring(size_t capacity) : slots(capacity) {}
+
+    std::vector<AccessLogEntry> slots;
+    alignas(detail::kCacheLineSize) std::atomic<size_t> head{0}; // producer
+    alignas(detail::kCacheLineSize) std::atomic<size_t> tail{0}; // writer
+  };
+
+  AccessLog() = default;
+
+  Ring &localRing();
+  void run();
+  // Format whatever the rings hold and write it out.
+  void drain();
+  void writeBatch();
+  bool openFile();
+  void rotateIfDue();
+
+  Options options;
+  std::atomic<bool> running{false};
+  std::mutex ringsMutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+
+  // Writer thread state.
+  std::thread writer;
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  int fd = -1;
+  uint64_t fileBytes = 0;
+  std::chrono::system_clock::time_point fileOpened;
+  std::vector<std::string> chunks; // one per ring, reused between batches
+  std::time_t formattedSecond = -1;
+  std::array<char, 32> formattedTime{};
+  size_t formattedTimeSize = 0;
+
+  Counter written;
+  Counter dropped;
+  Counter sampledOut;
+};
+
+AccessLog &AccessLog::instance() {
+  static AccessLog log;
+  return log;
+}
+
+AccessLog::~AccessLog() { close(); }
+
+bool AccessLog::open(Options configured) {
+  options = std::move(configured);
+  options.ringCapacity =
+      std::bit_ceil(std::max<size_t>(options.ringCapacity, 2));
+  if (!openFile()) {
+    return false;
+  }
+  stopping = false;
+  running = true;
+  writer = std::thread([this] { run(); });
+  return true;
+}
+
+void AccessLog::close() {
+  if (!running.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+  ::close(fd);
+  fd = -1;
+}
+
+AccessLog::Ring &AccessLog::localRing() {
+  thread_local Ring *ring = nullptr;
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.push_back(std::make_unique<Ring>(options.ringCapacity));
+    ring = rings.back().get();
+  }
+  return *ring;
+}
+
+void AccessLog::record(std::string_view remote, std::string_view method,
+                       std::string_view target, unsigned version,
+                       unsigned status, uint64_t bytesSent,
+                       std::chrono::steady_clock::duration elapsed) {
+  if (!enabled()) {
+    return;
+  }
+  if (options.sampleRate < 1.0 && status < 500) {
+    // xorshift: sampling needs to be cheap, not good
+    thread_local uint64_t state =
+        0x9e3779b97f4a7c15ull ^
+        std::hash<std::thread::id>{}(std::this_thread::get_id());
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (static_cast<double>(state >> 11) * 0x1.0p-53 >= options.sampleRate) {
+      sampledOut.add();
+      return;
+    }
+  }
+
+  Ring &ring = localRing();
+  size_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) == ring.slots.size()) {
+    dropped.add();
+    return;
+  }
+  AccessLogEntry &entry = ring.slots[head & (ring.slots.size() - 1)];
+  entry.unixMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+  entry.bytesSent = bytesSent;
+  entry.durationMicros = static_cast<uint32_t>(std::min<int64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+      UINT32_MAX));
+  entry.status = static_cast<uint16_t>(status);
+  entry.versionMajor = static_cast<uint8_t>(version / 10);
+  entry.versionMinor = static_cast<uint8_t>(version % 10);
+  entry.method = method;
+  entry.remoteSize =
+      static_cast<uint8_t>(std::min(remote.size(), entry.remote.size()));
+  std::copy_n(remote.data(), entry.remoteSize, entry.remote.data());
+  entry.targetSize =
+      static_cast<uint16_t>(std::min(target.size(), entry.target.size()));
+  std::copy_n(target.data(), entry.targetSize, entry.target.data());
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void AccessLog::run() {
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (!stopping) {
+    wake.wait_for(lock, options.flushInterval, [this] { return stopping; });
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+  lock.unlock();
+  drain(); // what was recorded before close
+}
+
+void AccessLog::drain() {
+  std::vector<Ring *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (auto &ring : rings) {
+      snapshot.push_back(ring.get());
+    }
+  }
+  chunks.resize(snapshot.size());
+  for (size_t r = 0; r < snapshot.size(); ++r) {
+    Ring &ring = *snapshot[r];
+    std::string &chunk = chunks[r];
+    chunk.clear();
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    size_t head = ring.head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      const auto &entry = ring.slots[tail & (ring.slots.size() - 1)];
+      std::time_t second = entry.unixMillis / 1000;
+      if (second != formattedSecond) {
+        std::tm parts{};
+        gmtime_r(&second, &parts);
+        formattedTimeSize = std::strftime(formattedTime.data(),
+                                          formattedTime.size(),
+                                          "%d/%b/%Y:%H:%M:%S +0000", &parts);
+        formattedSecond = second;
+      }
+      auto out = std::back_inserter(chunk);
+      fmt::format_to(out, "{} - - [{}] \"{} ",
+                     std::string_view(entry.remote.data(), entry.remoteSize),
+                     std::string_view(formattedTime.data(), formattedTimeSize),
+                     entry.method);
+      // Quotes and backslashes escaped as nginx does, so a target cannot
+      // end the request field early.
+      for (char c : std::string_view(entry.target.data(), entry.targetSize)) {
+        if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+          fmt::format_to(out, "\\x{:02X}", static_cast<unsigned char>(c));
+        } else {
+          chunk.push_back(c);
+        }
+      }
+      fmt::format_to(out, " HTTP/{}.{}\" {} {} {}\n", entry.versionMajor,
+                     entry.versionMinor, entry.status, entry.bytesSent,
+                     entry.durationMicros);
+      written.add();
+    }
+    ring.tail.store(tail, std::memory_order_release);
+  }
+  writeBatch();
+}
+
+void AccessLog::writeBatch() {
+  std::vector<iovec> pending;
+  for (auto &chunk : chunks) {
+    if (!chunk.empty()) {
+      pending.push_back(iovec{chunk.data(), chunk.size()});
+    }
+  }
+  size_t first = 0;
+  while (first < pending.size() && fd >= 0) {
+    int count = static_cast<int>(std::min<size_t>(pending.size() - first,
+                                                  IOV_MAX));
+    ssize_t bytes = ::writev(fd, pending.data() + first, count);
+    if (bytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      spdlog::error("access log write failed: {}", std::strerror(errno));
+      return;
+    }
+    fileBytes += static_cast<uint64_t>(bytes);
+    // Skip what was written, resuming partway into a buffer if need be.
+    auto remaining = static_cast<size_t>(bytes);
+    while (first < pending.size() && remaining >= pending[first].iov_len) {
+      remaining -= pending[first].iov_len;
+      ++first;
+    }
+    if (remaining > 0) {
+      pending[first].iov_base =
+          static_cast<char *>(pending[first].iov_base) + remaining;
+      pending[first].iov_len -= remaining;
+    }
+  }
+  rotateIfDue();
+}
+
+bool AccessLog::openFile() {
+  fd = ::open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+              0644);
+  if (fd < 0) {
+    spdlog::error("cannot open access log {}: {}", options.path,
+                  std::strerror(errno));
+    return false;
+  }
+  struct stat fileStat {};
+  fileBytes = ::fstat(fd, &fileStat) == 0 ? fileStat.st_size : 0;
+  fileOpened = std::chrono::system_clock::now();
+  return true;
+}
+
+void AccessLog::rotateIfDue() {
+  auto now = std::chrono::system_clock::now();
+  if (fileBytes < options.maxBytes && now - fileOpened < options.maxAge) {
+    return;
+  }
+  if (fileBytes == 0) {
+    fileOpened = now; // nothing to rotate yet
+    return;
+  }
+  std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+  std::tm parts{};
+  gmtime_r(&seconds, &parts);
+  char suffix[20];
+  std::strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &parts);
+  std::string rotated = options.path + suffix;
+  // Several rotations within a second (a tiny maxBytes) get numbered.
+  for (int n = 1; ::access(rotated.c_str(), F_OK) == 0; ++n) {
+    rotated = fmt::format("{}{}.{}", options.path, suffix, n);
+  }
+  if (std::rename(options.path.c_str(), rotated.c_str()) != 0) {
+    spdlog::error("cannot rotate access log to {}: {}", rotated,
+                  std::strerror(errno));
+    fileOpened = now; // try again after another maxAge, not every batch
+    return;
+  }
+  ::close(fd);
+  if (!openFile()) {
+    fd = -1;
+  }
+}
+
+void AccessLog::writeMetrics(std::string &out) const {
+  writeMetricHeader(out, "cms_access_log_lines_total", "counter",
+                    "Access log lines written.");
+  writeSample(out, "cms_access_log_lines_total", "", written.value());
+  writeMetricHeader(out, "cms_access_log_dropped_total", "counter",
+                    "Access log entries dropped because a ring was full.");
+  writeSample(out, "cms_access_log_dropped_total", "", dropped.value());
+  writeMetricHeader(out, "cms_access_log_sampled_out_total", "counter",
+                    "Requests left out of the access log by sampling.");
+  writeSample(out, "cms_access_log_sampled_out_total", "",
+              sampledOut.value());
+}
+
+/**
+ * Replace the default spdlog logger with an asynchronous one: callers only
+ * enqueue, and one background thread writes to stdout. When the bounded
+ * queue is full new messages are dropped, so logging never blocks a
+ * request.
+ */
+void installAsyncLogger(size_t queueSize = 8192) {
+  spdlog::init_thread_pool(queueSize, 1);
+  auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+#if SPDLOG_VERSION >= 11100
+  constexpr auto overflow = spdlog::async_overflow_policy::discard_new;
+#else
+  constexpr auto overflow = spdlog::async_overflow_policy::overrun_oldest;
+#endif
+  auto logger = std::make_shared<spdlog::async_logger>(
+      "", std::move(sink), spdlog::thread_pool(), overflow);
+  logger->set_level(spdlog::default_logger()->level());
+  spdlog::set_default_logger(std::move(logger));
+}
+
+} // namespace services
+
+#endif // CMS_ACCESS_LOG_HPP
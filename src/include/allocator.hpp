@@ -0,0 +1,135 @@
+#pragma once
+
+#ifndef CMS_ALLOCATOR_HPP
+#define CMS_ALLOCATOR_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+#include <cmark.h>
+
+#if defined(CMS_ALLOCATOR_MIMALLOC)
+#include <mimalloc.h>
+#elif defined(CMS_ALLOCATOR_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace cms {
+
+/**
+ * The heap allocator the server was built with (meson -Dallocator=...).
+ * mimalloc and jemalloc replace malloc and operator new for the whole
+ * process when linked, so rendered pages, cache copies and cmark's parse
+ * buffers all come from it; this header names it, hands cmark its entry
+ * points directly and reads its statistics.
+ */
+#if defined(CMS_ALLOCATOR_MIMALLOC)
+constexpr std::string_view kAllocatorName{"mimalloc"};
+#elif defined(CMS_ALLOCATOR_JEMALLOC)
+constexpr std::string_view kAllocatorName{"jemalloc"};
+#else
+constexpr std::string_view kAllocatorName{"glibc"};
+#endif
+
+// What the allocator holds: bytes handed to the program and bytes taken
+// from the OS for them. mimalloc does not count bytes in use cheaply, so
+// it reports only what it has committed.
+struct AllocatorStats {
+  std::string_view allocator;
+  std::optional<uint64_t> inUseBytes;
+  uint64_t heldBytes = 0;
+
+  // Share of held memory not in use: free chunks the allocator keeps.
+  std::optional<double> fragmentation() const {
+    if (!inUseBytes || heldBytes == 0) {
+      return std::nullopt;
+    }
+    return heldBytes > *inUseBytes
+               ? 1.0 - static_cast<double>(*inUseBytes) / heldBytes
+               : 0.0;
+  }
+};
+
+// The allocator's statistics; nullopt where it has none to give.
+std::optional<AllocatorStats> allocatorStats() {
+  AllocatorStats stats;
+  stats.allocator = kAllocatorName;
+#if defined(CMS_ALLOCATOR_MIMALLOC)
+  size_t commit = 0;
+  mi_process_info(nullptr, nullptr, nullptr, nullptr, nullptr, &commit,
+                  nullptr, nullptr);
+  stats.heldBytes = commit;
+  return stats;
+#elif defined(CMS_ALLOCATOR_JEMALLOC)
+  // Statistics are cached until the epoch is advanced.
+  uint64_t epoch = 1;
+  size_t size = sizeof(epoch);
+  mallctl("epoch", &epoch, &size, &epoch, size);
+  size_t allocated = 0;
+  size_t resident = 0;
+  size = sizeof(size_t);
+  if (mallctl("stats.allocated", &allocated, &size, nullptr, 0) != 0 ||
+      mallctl("stats.resident", &resident, &size, nullptr, 0) != 0) {
+    return std::nullopt; // built without --enable-stats
+  }
+  stats.inUseBytes = allocated;
+  stats.heldBytes = resident;
+  return stats;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2 info = ::mallinfo2();
+  stats.inUseBytes = info.uordblks + info.hblkhd;
+  stats.heldBytes = info.arena + info.hblkhd;
+  return stats;
+#else
+  return std::nullopt;
+#endif
+}
+
+namespace detail {
+
+#if defined(CMS_ALLOCATOR_MIMALLOC)
+// cmark's default allocator aborts when out of memory; so do these.
+void *mimallocCalloc(size_t count, size_t size) {
+  void *pointer = mi_calloc(count, size);
+  if (!pointer) {
+    std::abort();
+  }
+  return pointer;
+}
+
+void *mimallocRealloc(void *pointer, size_t size) {
+  void *grown = mi_realloc(pointer, size);
+  if (!grown) {
+    std::abort();
+  }
+  return grown;
+}
+#endif
+
+} // namespace detail
+
+// cmark allocator over the server's heap allocator, for renders outside a
+// RenderArena scope.
+cmark_mem *heapCmarkAllocator() {
+#if defined(CMS_ALLOCATOR_MIMALLOC)
+  static cmark_mem allocator{detail::mimallocCalloc, detail::mimallocRealloc,
+                             mi_free};
+  return &allocator;
+#else
+  // malloc itself is jemalloc when linked, so cmark's default is already it.
+  return cmark_get_default_mem_allocator();
+#endif
+}
+
+} // namespace cms
+
+#endif // CMS_ALLOCATOR_HPP
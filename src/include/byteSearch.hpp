@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef CMS_BYTE_SEARCH_HPP
+#define CMS_BYTE_SEARCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cms {
+
+/**
+ * Offset of the first byte of text at or after pos that equals one of
+ * bytes[0] .. bytes[Count - 1], or text.size(). Text is compared a vector
+ * at a time (AVX2, SSE2 or NEON, whichever the build targets) and the tail
+ * shorter than a vector byte by byte. Count is a template parameter so the
+ * compares per vector unroll.
+ */
+template <size_t Count>
+size_t findAnyByte(std::string_view text, const char *bytes, size_t pos = 0) {
+  static_assert(Count > 0, "Nothing to search for");
+  const char *data = text.data();
+  const size_t size = text.size();
+#if defined(__AVX2__)
+  __m256i wanted[Count];
+  for (size_t i = 0; i < Count; ++i) {
+    wanted[i] = _mm256_set1_epi8(bytes[i]);
+  }
+  for (; pos + 32 <= size; pos += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+    __m256i any = _mm256_cmpeq_epi8(block, wanted[0]);
+    for (size_t i = 1; i < Count; ++i) {
+      any = _mm256_or_si256(any, _mm256_cmpeq_epi8(block, wanted[i]));
+    }
+    if (uint32_t mask = _mm256_movemask_epi8(any)) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#elif defined(__SSE2__)
+  __m128i wanted[Count];
+  for (size_t i = 0; i < Count; ++i) {
+    wanted[i] = _mm_set1_epi8(bytes[i]);
+  }
+  for (; pos + 16 <= size; pos += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    __m128i any = _mm_cmpeq_epi8(block, wanted[0]);
+    for (size_t i = 1; i < Count; ++i) {
+      any = _mm_or_si128(any, _mm_cmpeq_epi8(block, wanted[i]));
+    }
+    if (uint32_t mask = _mm_movemask_epi8(any)) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#elif defined(__ARM_NEON)
+  uint8x16_t wanted[Count];
+  for (size_t i = 0; i < Count; ++i) {
+    wanted[i] = vdupq_n_u8(static_cast<uint8_t>(bytes[i]));
+  }
+  for (; pos + 16 <= size; pos += 16) {
+    uint8x16_t block =
+        vld1q_u8(reinterpret_cast<const uint8_t *>(data + pos));
+    uint8x16_t any = vceqq_u8(block, wanted[0]);
+    for (size_t i = 1; i < Count; ++i) {
+      any = vorrq_u8(any, vceqq_u8(block, wanted[i]));
+    }
+    // Narrow to four bits per byte, NEON having no movemask.
+    uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(any), 4)), 0);
+    if (mask) {
+      return pos + (__builtin_ctzll(mask) >> 2);
+    }
+  }
+#endif
+  for (; pos < size; ++pos) {
+    for (size_t i = 0; i < Count; ++i) {
+      if (data[pos] == bytes[i]) {
+        return pos;
+      }
+    }
+  }
+  return size;
+}
+
+} // namespace cms
+
+#endif // CMS_BYTE_SEARCH_HPP
@@ -0,0 +1,190 @@
+#pragma once
+
+#ifndef CMS_CIRCUIT_BREAKER_HPP
+#define CMS_CIRCUIT_BREAKER_HPP
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace services {
+
+/**
+ * Error rate and latency based circuit breaker.
+ *
+ * Closed: calls go through and their outcome is kept in a rolling window.
+ * Slow calls count as failures. Once the window holds enough calls and the
+ * failure ratio reaches the threshold the breaker opens.
+ * Open: calls are rejected until openDuration has passed.
+ * HalfOpen: a single probe call is let through; its outcome closes or
+ * re-opens the breaker. Calls admitted while closed that finish meanwhile
+ * are ignored, so a late one cannot decide in the probe's place.
+ */
+class CircuitBreaker {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class State : int { Closed = 0, Open = 1, HalfOpen = 2 };
+
+  struct Options {
+    size_t windowSize = 20;
+    size_t minimumCalls = 5;
+    double failureRatio = 0.5;
+    Clock::duration slowCall = std::chrono::seconds(2);
+    Clock::duration openDuration = std::chrono::seconds(10);
+  };
+
+  explicit CircuitBreaker(Options options);
+  ~CircuitBreaker() = default;
+
+  // Admission of one call; its outcome is recorded with the same permit.
+  struct Permit {
+    bool allowed = false;
+    bool probe = false; // the half-open probe, whose outcome decides
+    explicit operator bool() const { return allowed; }
+  };
+
+  // Whether the call may proceed. In the half-open state only the first
+  // caller gets through, as the probe.
+  Permit allow();
+
+  void recordSuccess(const Permit &permit, Clock::duration elapsed);
+  void recordFailure(const Permit &permit);
+
+  State state() const;
+
+  // Time left until the breaker lets a probe through, at least one second.
+  std::chrono::seconds retryAfter() const;
+
+  void writePrometheus(string &out, std::string_view name) const;
+
+private:
+  void record(const Permit &permit, bool failed);
+  void open(Clock::time_point now);
+
+  const Options options;
+  mutable std::mutex mutex;
+  std::vector<bool> window;
+  size_t windowNext = 0;
+  size_t windowCount = 0;
+  size_t windowFailures = 0;
+  State current = State::Closed;
+  Clock::time_point openedAt{};
+  bool probeInFlight = false;
+  std::atomic<uint64_t> rejected{0};
+  std::atomic<uint64_t> opened{0};
+};
+
+CircuitBreaker::CircuitBreaker(Options options)
+    : options(options), window(std::max<size_t>(1, options.windowSize)) {}
+
+CircuitBreaker::Permit CircuitBreaker::allow() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (current == State::Closed) {
+    return Permit{true, false};
+  }
+  if (current == State::Open &&
+      Clock::now() - openedAt >= options.openDuration) {
+    current = State::HalfOpen;
+    probeInFlight = false;
+  }
+  if (current == State::HalfOpen && !probeInFlight) {
+    probeInFlight = true;
+    return Permit{true, true};
+  }
+  rejected.fetch_add(1, std::memory_order_relaxed);
+  return Permit{};
+}
+
+void CircuitBreaker::recordSuccess(const Permit &permit,
+                                   Clock::duration elapsed) {
+  record(permit, elapsed >= options.slowCall);
+}
+
+void CircuitBreaker::recordFailure(const Permit &permit) {
+  record(permit, true);
+}
+
+void CircuitBreaker::record(const Permit &permit, bool failed) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (current == State::HalfOpen) {
+    if (!permit.probe) {
+      // Admitted while closed and finished late; only the probe decides.
+      return;
+    }
+    probeInFlight = false;
+    if (failed) {
+      open(Clock::now());
+    } else {
+      current = State::Closed;
+      windowNext = windowCount = windowFailures = 0;
+    }
+    return;
+  }
+  if (current == State::Open) {
+    // A call admitted before the breaker opened finished late.
+    return;
+  }
+
+  if (windowCount == window.size()) {
+    windowFailures -= window[windowNext] ? 1 : 0;
+  } else {
+    ++windowCount;
+  }
+  window[windowNext] = failed;
+  windowFailures += failed ? 1 : 0;
+  windowNext = (windowNext + 1) % window.size();
+
+  if (windowCount >= options.minimumCalls &&
+      static_cast<double>(windowFailures) >=
+          options.failureRatio * static_cast<double>(windowCount)) {
+    open(Clock::now());
+  }
+}
+
+void CircuitBreaker::open(Clock::time_point now) {
+  current = State::Open;
+  openedAt = now;
+  windowNext = windowCount = windowFailures = 0;
+  opened.fetch_add(1, std::memory_order_relaxed);
+}
+
+CircuitBreaker::State CircuitBreaker::state() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return current;
+}
+
+std::chrono::seconds CircuitBreaker::retryAfter() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto remaining = options.openDuration - (Clock::now() - openedAt);
+  auto seconds = std::chrono::ceil<std::chrono::seconds>(remaining);
+  return std::max(seconds, std::chrono::seconds(1));
+}
+
+void CircuitBreaker::writePrometheus(string &out, std::string_view name) const {
+  auto stateName = fmt::format("{}_state", name);
+  writeMetricHeader(out, stateName, "gauge",
+                    "Circuit breaker state (0 closed, 1 open, 2 half-open).");
+  writeSample(out, stateName, "", static_cast<uint64_t>(state()));
+
+  auto openedName = fmt::format("{}_opened_total", name);
+  writeMetricHeader(out, openedName, "counter",
+                    "Times the circuit breaker has opened.");
+  writeSample(out, openedName, "", opened.load(std::memory_order_relaxed));
+
+  auto rejectedName = fmt::format("{}_rejected_total", name);
+  writeMetricHeader(out, rejectedName, "counter",
+                    "Calls rejected while the circuit breaker was open.");
+  writeSample(out, rejectedName, "", rejected.load(std::memory_order_relaxed));
+}
+
+} // namespace services
+
+#endif // CMS_CIRCUIT_BREAKER_HPP
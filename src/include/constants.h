@@ -5,12 +5,17 @@
 
 #define CONTENT_TYPE_HTML "text/html"
 #define CONTENT_TYPE_JSON "application/json"
+#define CONTENT_TYPE_METRICS "text/plain; version=0.0.4"
+#define METRICS_PATH "/_cms/metrics"
 
 const char *ANY_IPV4_HOST = "0.0.0.0";
+const char *LOOPBACK_IPV4_HOST = "127.0.0.1";
 const int MAX_DB_CONNECTION = 10;
 const int MODE_MARKDOWN = 1;
 const int MODE_HTML = 2;
+const int MODE_PLAIN = 3;
 const int DEFAULT_PORT = 10000;
+const int DEFAULT_ADMIN_PORT = 10001;
 const int NONE_POST_ID = 0;
 const long unsigned int MAX_POST_URL_SEGMENTS = 10;
 
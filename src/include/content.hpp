@@ -8,8 +8,17 @@
 # Includes
 ###############################################################################
 ***/
+#include "circuitBreaker.hpp"
+#include "contentStore.hpp"
+#include "dateFormat.hpp"
+#include "htmlEscape.hpp"
 #include "keyValueCache.hpp"
+#include "layoutTemplate.hpp"
+#include "markdown.hpp"
+#include "renderArena.hpp"
+#include "requestTrace.hpp"
 #include "stringUtil.hpp"
+#include <atomic>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <bsoncxx/builder/basic/document.hpp>
@@ -18,12 +27,13 @@
 #include <bsoncxx/json.hpp>
 #include <bsoncxx/stdx/string_view.hpp>
 #include <bsoncxx/types.hpp>
-#include <charconv>
+#include <chrono>
 #include <cmark.h>
-#include <mongocxx/client.hpp>
-#include <mongocxx/pipeline.hpp>
-#include <mongocxx/pool.hpp>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <string>
 
 /***
@@ -47,164 +57,467 @@ using std::string;
 namespace pt = boost::posix_time;
 namespace gr = boost::gregorian;
 
-constexpr bsoncxx::stdx::string_view kIdField{"id"};
-constexpr bsoncxx::stdx::string_view kFromField{"from"};
-constexpr bsoncxx::stdx::string_view kLocalField{"localField"};
-constexpr bsoncxx::stdx::string_view kForeignField{"foreignField"};
 constexpr bsoncxx::stdx::string_view kModesCollection{"modes"};
-constexpr bsoncxx::stdx::string_view kModeIdField{"modeId"};
 constexpr bsoncxx::stdx::string_view kLayoutsCollection{"layouts"};
-constexpr bsoncxx::stdx::string_view kLayoutIdField{"layoutId"};
 constexpr bsoncxx::stdx::string_view kPostsCollection{"posts"};
 constexpr bsoncxx::stdx::string_view kPagesCollection{"pages"};
-constexpr bsoncxx::stdx::string_view kTitleField{"title"};
-constexpr bsoncxx::stdx::string_view kContentField{"content"};
-constexpr bsoncxx::stdx::string_view kHeaderField{"header"};
-constexpr bsoncxx::stdx::string_view kFooterField{"footer"};
-constexpr bsoncxx::stdx::string_view kLayoutField{"layout"};
-constexpr bsoncxx::stdx::string_view kCreatedAtField{"createdAt"};
+
+constexpr int64_t kCacheTtlSeconds = 900;        // 15 minutes
+constexpr int64_t kStaleCacheTtlSeconds = 86400; // 1 day
+constexpr size_t kStaleCacheCapacity = 100;
+// Rendered bodies by document version, reused when a page's TTL expires
+// but its document has not changed.
+constexpr size_t kFragmentCacheCapacity = 256;
+constexpr int64_t kFragmentCacheTtlSeconds = 86400; // 1 day
+// How often the layout of a cached page is refetched, so a layout edit
+// reaches cached pages without re-rendering them.
+constexpr std::chrono::seconds kLayoutRecheckInterval{30};
+// Oldest stale copy a streamed head is built from; past this the document
+// may well be gone, and the page is served whole instead.
+constexpr std::chrono::seconds kStreamHeadMaxAge{3600};
+
+// Request path of a page or post, e.g. "/", "/about" or "/posts/3".
+string contentPath(std::string_view collectionName, std::string_view idValue) {
+  if (collectionName == kPostsCollection) {
+    return "/posts/" + string(idValue);
+  }
+  if (idValue == "index") {
+    return "/";
+  }
+  return "/" + string(idValue);
+}
+
+/**
+ * What the page caches hold: only the bytes unique to a page, plus the
+ * layout that wraps them. Cached pages are assembled against the newest
+ * compiled version of their layout, so a layout edit does not require
+ * re-rendering them.
+ */
+struct CachedPage {
+  string dbName;
+  int layoutId = 0;
+  std::shared_ptr<const LayoutTemplate> layout; // null: slots hold the page
+  PageSlots slots;
+  // When the document was last fetched; unset for fragments.
+  std::chrono::steady_clock::time_point fetchedAt{};
+
+  // Bytes held, for the cache metrics.
+  size_t size() const { return slots.size(); }
+};
+
+using PageCache = services::BasicKeyValueCache<CachedPage>;
+
+// Thrown when content cannot be fetched and no stale copy is available.
+class ContentUnavailable : public std::runtime_error {
+public:
+  ContentUnavailable(const string &what, std::chrono::seconds retryAfter)
+      : std::runtime_error(what), retryAfter_(retryAfter) {}
+
+  std::chrono::seconds retryAfter() const { return retryAfter_; }
+
+private:
+  std::chrono::seconds retryAfter_;
+};
 
 class Content {
 public:
-  explicit Content(std::shared_ptr<mongocxx::pool> dbPool,
-                   services::KeyValueCache &cacheRef);
+  explicit Content(std::shared_ptr<ContentStore> contentStore,
+                   PageCache &cacheRef);
 
   // Default destructor
   ~Content() = default;
 
-  string
-  render(const std::string_view &host, const bsoncxx::stdx::string_view &dbName,
-         const string &cachePrefix,
-         const bsoncxx::stdx::string_view &collectionName,
-         const ContentIdType &idType, const bsoncxx::stdx::string_view &idField,
-         const string &idValue, const bsoncxx::stdx::string_view &titleField);
+  RenderedPage render(const std::string_view &host,
+                      const bsoncxx::stdx::string_view &dbName,
+                      const string &cachePrefix,
+                      const bsoncxx::stdx::string_view &collectionName,
+                      const ContentIdType &idType, const string &idValue);
+
+  // For streaming a page that is not cached: the layout up to the body,
+  // filled from the stale tier's copy so it can be sent before the fetch.
+  // Empty when the page is cached or no copy newer than kStreamHeadMaxAge
+  // is known.
+  std::optional<RenderedPage>
+  renderHead(const bsoncxx::stdx::string_view &dbName,
+             const string &cachePrefix, const string &idValue);
+
+  // The rest of a page whose head was sent: renders the document and lays
+  // its body and trailing slots out in the head's layout. Empty when the
+  // document no longer exists.
+  RenderedPage renderTail(const RenderedPage &head,
+                          const std::string_view &host,
+                          const bsoncxx::stdx::string_view &dbName,
+                          const string &cachePrefix,
+                          const bsoncxx::stdx::string_view &collectionName,
+                          const ContentIdType &idType, const string &idValue);
+
+  // Render a document into a full page with its layout, bypassing the page
+  // caches; path fills the canonical slot. A document that carries
+  // pre-rendered HTML is returned as is.
+  string renderDocument(std::string_view dbName, std::string_view path,
+                        const ContentDocument &document) const;
+
+  // The cacheable part of a rendered document.
+  CachedPage composePage(std::string_view dbName, std::string_view path,
+                         const ContentDocument &document) const;
+
+  RenderedPage assemble(const CachedPage &page) const;
+
+  std::shared_ptr<ContentStore> getStore() const { return store; }
+
+  // Circuit breaker, cache and render metrics in Prometheus text format.
+  void writeMetrics(string &out) const;
 
 private:
-  std::shared_ptr<mongocxx::pool> pool;
-  services::KeyValueCache &cache;
+  static string cacheKeyFor(const bsoncxx::stdx::string_view &dbName,
+                            const string &cachePrefix, const string &idValue);
+
+  // The compiled layout a document is rendered with.
+  std::shared_ptr<const LayoutTemplate>
+  layoutFor(std::string_view dbName, const ContentDocument &document) const;
+
+  // composePage, reusing the body fragment of the same document version.
+  CachedPage composeFragment(std::string_view dbName,
+                             std::string_view collectionName,
+                             const string &idValue,
+                             const ContentDocument &document);
+
+  // Refetch the layout of a cached page when its recheck is due.
+  void revalidateLayout(const CachedPage &page);
+
+  // Last known good copy of a page, or ContentUnavailable.
+  RenderedPage serveStale(const string &cacheKey, std::string_view reason);
+
+  std::shared_ptr<ContentStore> store;
+  PageCache &cache;
+  // Rendered pages kept past their TTL for use while MongoDB is unavailable.
+  PageCache staleCache;
+  // Body fragments keyed by db/collection/id@updatedAt.
+  PageCache fragments;
+  services::CircuitBreaker breaker;
+  std::atomic<uint64_t> staleServed{0};
+  std::atomic<uint64_t> fragmentHits{0};
+  std::atomic<uint64_t> layoutRechecks{0};
+  services::ShardedHistogram fetchLatency;
+  services::ShardedHistogram renderLatency;
+  mutable LayoutTemplateCache layouts;
 };
 
-Content::Content(std::shared_ptr<mongocxx::pool> dbPool,
-                 services::KeyValueCache &cacheRef)
-    : pool(dbPool), cache(cacheRef) {
-  if (!pool) {
-    throw std::invalid_argument("Invalid or null mongodb pool");
+Content::Content(std::shared_ptr<ContentStore> contentStore,
+                 PageCache &cacheRef)
+    : store(contentStore), cache(cacheRef), staleCache(kStaleCacheCapacity),
+      fragments(kFragmentCacheCapacity),
+      breaker(services::CircuitBreaker::Options{}) {
+  if (!store) {
+    throw std::invalid_argument("Invalid or null content store");
   }
 }
 
-string Content::render(
-    const std::string_view &host, const bsoncxx::stdx::string_view &dbName,
-    const string &cachePrefix, const bsoncxx::stdx::string_view &collectionName,
-    const ContentIdType &idType, const bsoncxx::stdx::string_view &idField,
-    const string &idValue, const bsoncxx::stdx::string_view &titleField) {
-  string cacheKey{dbName};
+RenderedPage Content::render(const std::string_view &host,
+                             const bsoncxx::stdx::string_view &dbName,
+                             const string &cachePrefix,
+                             const bsoncxx::stdx::string_view &collectionName,
+                             const ContentIdType &idType,
+                             const string &idValue) {
+  string cacheKey = cacheKeyFor(dbName, cachePrefix, idValue);
+
+  // Check cache
+  auto cacheValue = cache.get(cacheKey);
+  services::RequestTrace::markActive(services::RequestPhase::CacheLookup);
+  if (cacheValue) {
+    revalidateLayout(cacheValue.value());
+    return assemble(cacheValue.value());
+  }
+
+  auto permit = breaker.allow();
+  if (!permit) {
+    return serveStale(cacheKey, "circuit breaker open");
+  }
+
+  std::optional<ContentDocument> document;
+  try {
+    auto fetchStart = std::chrono::steady_clock::now();
+    document = store->getDocument(
+        std::string_view(dbName.data(), dbName.size()),
+        std::string_view(collectionName.data(), collectionName.size()), idType,
+        idValue);
+    auto fetchTime = std::chrono::steady_clock::now() - fetchStart;
+    services::RequestTrace::markActive(services::RequestPhase::Fetched);
+    breaker.recordSuccess(permit, fetchTime);
+    fetchLatency.record(fetchTime);
+  } catch (const std::exception &e) {
+    breaker.recordFailure(permit);
+    spdlog::error("Content::render exception: {}", e.what());
+    return serveStale(cacheKey, e.what());
+  }
+
+  CachedPage result;
+  if (document) {
+    auto renderStart = std::chrono::steady_clock::now();
+    result = composeFragment(
+        std::string_view(dbName.data(), dbName.size()),
+        std::string_view(collectionName.data(), collectionName.size()),
+        idValue, *document);
+    renderLatency.record(std::chrono::steady_clock::now() - renderStart);
+    result.fetchedAt = std::chrono::steady_clock::now();
+    staleCache.put(cacheKey, result, kStaleCacheTtlSeconds);
+  } else {
+    spdlog::warn("No result for Content::render => {}", idValue);
+  }
+
+  // Cache result
+  if (cache.set(cacheKey, result, kCacheTtlSeconds)) {
+    spdlog::info("get {} ({}) set cache ({})", cachePrefix, idValue, cacheKey);
+  } else {
+    spdlog::error("get {} ({}) failed to set cache ({})", cachePrefix, idValue,
+                  cacheKey);
+  }
+  return assemble(result);
+}
+
+string Content::cacheKeyFor(const bsoncxx::stdx::string_view &dbName,
+                            const string &cachePrefix, const string &idValue) {
+  string cacheKey;
+  cacheKey.reserve(dbName.size() + cachePrefix.size() + idValue.size() + 2);
+  cacheKey.append(dbName.data(), dbName.size());
   cacheKey.append("_");
   cacheKey.append(cachePrefix);
   cacheKey.append("_");
   cacheKey.append(idValue);
+  return cacheKey;
+}
 
-  // Check cache
-  if (auto cacheValue = cache.get(cacheKey)) {
-    return cacheValue.value();
+std::optional<RenderedPage>
+Content::renderHead(const bsoncxx::stdx::string_view &dbName,
+                    const string &cachePrefix, const string &idValue) {
+  string cacheKey = cacheKeyFor(dbName, cachePrefix, idValue);
+  // Peeked, not counted: render() does the counted lookup right after.
+  bool cached = cache.peek(cacheKey).has_value();
+  services::RequestTrace::markActive(services::RequestPhase::CacheLookup);
+  if (cached) {
+    return std::nullopt; // served whole without waiting on the store
   }
+  auto hint = staleCache.peek(cacheKey);
+  if (!hint || !hint->layout ||
+      std::chrono::steady_clock::now() - hint->fetchedAt > kStreamHeadMaxAge) {
+    return std::nullopt;
+  }
+  auto layout = layouts.current(hint->dbName, hint->layoutId);
+  return LayoutTemplate::assemble(layout ? layout : hint->layout, hint->slots,
+                                  PagePart::Head);
+}
+
+RenderedPage Content::renderTail(
+    const RenderedPage &head, const std::string_view &host,
+    const bsoncxx::stdx::string_view &dbName, const string &cachePrefix,
+    const bsoncxx::stdx::string_view &collectionName,
+    const ContentIdType &idType, const string &idValue) {
+  auto page =
+      render(host, dbName, cachePrefix, collectionName, idType, idValue);
+  if (page.empty()) {
+    return {};
+  }
+  // Keep the layout the head was sent with, even if the document moved to
+  // another one in the meantime.
+  return LayoutTemplate::assemble(head.layout, page.slots, PagePart::Tail);
+}
 
-  string content;
-  string titleTag;
+string Content::renderDocument(std::string_view dbName, std::string_view path,
+                               const ContentDocument &document) const {
+  return assemble(composePage(dbName, path, document)).str();
+}
+
+std::shared_ptr<const LayoutTemplate>
+Content::layoutFor(std::string_view dbName,
+                   const ContentDocument &document) const {
+  // Keyed on the content: a layout edited without bumping its updatedAt
+  // still compiles again.
+  return layouts.get(dbName, document.layoutId,
+                     layoutContentVersion(document.header, document.footer),
+                     document.header, document.footer);
+}
 
+CachedPage Content::composeFragment(std::string_view dbName,
+                                    std::string_view collectionName,
+                                    const string &idValue,
+                                    const ContentDocument &document) {
+  auto path = contentPath(collectionName, idValue);
+  // Without an updatedAt there is no version to key the body by.
+  if (document.updatedAt == 0 || !document.rendered.empty()) {
+    return composePage(dbName, path, document);
+  }
+  string key;
+  key.reserve(dbName.size() + collectionName.size() + idValue.size() + 24);
+  key.append(dbName);
+  key.append("/");
+  key.append(collectionName);
+  key.append("/");
+  key.append(idValue);
+  key.append("@");
+  key.append(std::to_string(document.updatedAt));
+  if (auto fragment = fragments.get(key)) {
+    fragmentHits.fetch_add(1, std::memory_order_relaxed);
+    // Same body; the layout comes with the fetched document.
+    fragment->layoutId = document.layoutId;
+    fragment->layout = layoutFor(dbName, document);
+    return *fragment;
+  }
+  auto page = composePage(dbName, path, document);
+  fragments.put(key, page, kFragmentCacheTtlSeconds);
+  return page;
+}
+
+void Content::revalidateLayout(const CachedPage &page) {
+  if (!page.layout || !layouts.claimRecheck(page.dbName, page.layoutId,
+                                             kLayoutRecheckInterval)) {
+    return;
+  }
+  auto permit = breaker.allow();
+  if (!permit) {
+    return;
+  }
   try {
-    auto client = pool->acquire();
-    auto db = client[dbName];
-    auto collection = db[collectionName];
-
-    mongocxx::pipeline byIdPipeline;
-    byIdPipeline.lookup(make_document(
-        kvp(kFromField, kModesCollection), kvp(kLocalField, kModeIdField),
-        kvp(kForeignField, kIdField), kvp("as", "mode")));
-    byIdPipeline.unwind("$mode");
-    byIdPipeline.lookup(make_document(
-        kvp(kFromField, kLayoutsCollection), kvp(kLocalField, kLayoutIdField),
-        kvp(kForeignField, kIdField), kvp("as", "layout")));
-    byIdPipeline.unwind("$layout");
-    if (idType == ContentIdType::Integer) {
-      int idNum = 0;
-      auto [ptr, ec] = std::from_chars(idValue.data(),
-                                       idValue.data() + idValue.size(), idNum);
-      if (!(ec == std::errc() && ptr == idValue.data() + idValue.size())) {
-        idNum = 0;
-      }
-      byIdPipeline.match(make_document(kvp(idField, idNum)));
-    } else {
-      byIdPipeline.match(make_document(kvp(idField, idValue)));
+    auto fetchStart = std::chrono::steady_clock::now();
+    auto layout = store->getLayout(page.dbName, page.layoutId);
+    breaker.recordSuccess(permit,
+                          std::chrono::steady_clock::now() - fetchStart);
+    if (layout) {
+      layouts.get(page.dbName, page.layoutId,
+                  layoutContentVersion(layout->header, layout->footer),
+                  layout->header, layout->footer);
+      layoutRechecks.fetch_add(1, std::memory_order_relaxed);
     }
+  } catch (const std::exception &e) {
+    breaker.recordFailure(permit);
+    spdlog::warn("layout {} of {} recheck failed: {}", page.layoutId,
+                 page.dbName, e.what());
+  }
+}
+
+CachedPage Content::composePage(std::string_view dbName, std::string_view path,
+                                const ContentDocument &document) const {
+  CachedPage page;
+  page.dbName = string(dbName);
+  page.layoutId = document.layoutId;
+
+  if (!document.rendered.empty()) {
+    LayoutSlotValues slots;
+    slots[LayoutSlot::Body] = document.rendered;
+    page.slots = PageSlots(slots);
+    return page;
+  }
+
+  page.layout = layoutFor(dbName, document);
 
-    auto cursor = collection.aggregate(byIdPipeline);
-
-    int modeId = MODE_HTML;
-    bool found = false;
-    for (const auto &doc : cursor) {
-      found = true;
-      if (doc[idField]) {
-        modeId = doc[kModeIdField].type() == bsoncxx::type::k_int32
-                     ? doc[kModeIdField].get_int32().value
-                     : static_cast<int>(doc[kModeIdField].get_int64().value);
-      }
-
-      auto titleValue = doc[titleField].get_string().value;
-      titleTag.append("<title>");
-      titleTag.append(titleValue.data(), titleValue.size());
-      titleTag.append("</title>");
-
-      auto headerValue = doc[kLayoutField][kHeaderField].get_string().value;
-      content.append(headerValue.data(), headerValue.size());
-
-      auto contentValue = doc[kContentField].get_string().value;
-      bsoncxx::types::b_date createdAt = doc[kCreatedAtField].get_date();
-
-      if (modeId == MODE_MARKDOWN) {
-        auto html = std::unique_ptr<char, void (*)(void *)>(
-            cmark_markdown_to_html(contentValue.data(), contentValue.size(),
-                                   CMARK_OPT_DEFAULT),
-            std::free);
-        content.append("<h1>");
-        content.append(titleValue.data(), titleValue.size());
-        content.append("</h1><h4>");
-        content.append(string_util::timestamp(createdAt));
-        content.append("</h4>");
-        content.append(html.get());
-      } else if (modeId == MODE_HTML) {
-        content.append(contentValue.data(), contentValue.size());
-      }
-
-      auto footerValue = doc[kLayoutField][kFooterField].get_string().value;
-      content.append(footerValue.data(), footerValue.size());
-
-      /***
-       * //DEBUG
-       * std::cout << bsoncxx::to_json(doc) << std::endl;
-       ***/
-      break;
+  // Valid until this thread formats another date; PageSlots copies it.
+  std::string_view date;
+  if (document.createdAt != 0) {
+    date = services::ContentDateCache::format(document.createdAt);
+  }
+
+  // Render temporaries live in the thread's arena; PageSlots copies what
+  // the page keeps into one allocation.
+  RenderArena::Scope arena;
+  // Document fields are text: escape them wherever they are interpolated.
+  // The date is formatted here and needs no escaping.
+  std::pmr::string title(arena.resource());
+  std::pmr::string description(arena.resource());
+  std::pmr::string canonical(arena.resource());
+  appendHtmlEscaped(document.title, title);
+  appendHtmlEscaped(document.description, description);
+  appendHtmlEscaped(path, canonical);
+
+  std::pmr::string body(arena.resource());
+  LayoutSlotValues slots;
+  slots[LayoutSlot::Title] = title;
+  slots[LayoutSlot::Description] = description;
+  slots[LayoutSlot::Canonical] = canonical;
+  slots[LayoutSlot::Date] = date;
+  if (document.modeId == MODE_MARKDOWN || document.modeId == MODE_PLAIN) {
+    bool stored = document.modeId == MODE_MARKDOWN &&
+                  !document.renderedHtml.empty() &&
+                  document.renderedHash == markdownHash(document.content);
+    // cmark output and escaped text run about a quarter larger than their
+    // source.
+    body.reserve(title.size() + date.size() + 29 +
+                 (stored ? document.renderedHtml.size()
+                         : document.content.size() * 5 / 4));
+    body.append("<h1>");
+    body.append(title);
+    body.append("</h1><h4>");
+    body.append(date);
+    body.append("</h4>");
+    if (document.modeId == MODE_PLAIN) {
+      body.append("<pre>");
+      appendHtmlEscaped(document.content, body);
+      body.append("</pre>");
+    } else if (stored) {
+      // Stored HTML from render-on-write, unless the source or cmark changed.
+      body.append(document.renderedHtml);
+    } else {
+      appendMarkdownHtml(document.content, body);
     }
+    slots[LayoutSlot::Body] = body;
+  } else if (document.modeId == MODE_HTML) {
+    slots[LayoutSlot::Body] = document.content;
+  }
+  services::RequestTrace::markActive(services::RequestPhase::Rendered);
+  page.slots = PageSlots(slots);
+  return page;
+}
 
-    if (!found) {
-      spdlog::warn("No result for Content::render => {}", idValue);
+RenderedPage Content::assemble(const CachedPage &page) const {
+  auto layout = page.layout;
+  if (layout) {
+    if (auto latest = layouts.current(page.dbName, page.layoutId)) {
+      layout = std::move(latest);
     }
-  } catch (const std::exception &e) {
-    spdlog::error("Content::render exception: {}", e.what());
   }
+  auto rendered = LayoutTemplate::assemble(std::move(layout), page.slots);
+  services::RequestTrace::markActive(services::RequestPhase::Replaced);
+  return rendered;
+}
 
-  // Replace title tag
-  string_util::StringReplacer replacer("<title>%REPLACE_WITH_TITLE_ID%</title>",
-                                       titleTag);
-  string result = replacer.replace(content, 1);
-  // Cache result
-  int64_t ttl = 900; // 15 minutes
-  if (cache.set(cacheKey, result, ttl)) {
-    spdlog::info("get {} ({}) set cache ({})", cachePrefix, idValue, cacheKey);
-  } else {
-    spdlog::error("get {} ({}) failed to set cache ({})", cachePrefix, idValue,
-                  cacheKey);
+RenderedPage Content::serveStale(const string &cacheKey,
+                                 std::string_view reason) {
+  if (auto staleValue = staleCache.get(cacheKey)) {
+    staleServed.fetch_add(1, std::memory_order_relaxed);
+    spdlog::warn("serving stale copy of {} ({})", cacheKey, reason);
+    return assemble(staleValue.value());
   }
-  return result;
+  throw ContentUnavailable(string(reason), breaker.retryAfter());
+}
+
+void Content::writeMetrics(string &out) const {
+  breaker.writePrometheus(out, "cms_content_breaker");
+  services::writeMetricHeader(out, "cms_content_stale_served_total", "counter",
+                              "Pages served from the stale tier.");
+  services::writeSample(out, "cms_content_stale_served_total", "",
+                        staleServed.load(std::memory_order_relaxed));
+  services::writeMetricHeader(out, "cms_content_fragment_hits_total",
+                              "counter",
+                              "Pages rebuilt from a cached body fragment.");
+  services::writeSample(out, "cms_content_fragment_hits_total", "",
+                        fragmentHits.load(std::memory_order_relaxed));
+  services::writeMetricHeader(out, "cms_content_layout_rechecks_total",
+                              "counter",
+                              "Layouts of cached pages refetched.");
+  services::writeSample(out, "cms_content_layout_rechecks_total", "",
+                        layoutRechecks.load(std::memory_order_relaxed));
+  services::writeCacheMetrics(out, "cms_cache",
+                              {{"pages", cache.stats()},
+                               {"stale", staleCache.stats()},
+                               {"fragments", fragments.stats()}});
+  services::writeMetricHeader(out, "cms_content_fetch_duration_seconds",
+                              "histogram",
+                              "Time to fetch a document from the store.");
+  services::writeHistogram(out, "cms_content_fetch_duration_seconds", "",
+                           fetchLatency.snapshot());
+  services::writeMetricHeader(out, "cms_content_render_duration_seconds",
+                              "histogram",
+                              "Time to render a fetched document.");
+  services::writeHistogram(out, "cms_content_render_duration_seconds", "",
+                           renderLatency.snapshot());
 }
 
 } // namespace cms
@@ -0,0 +1,594 @@
+#pragma once
+
+#ifndef CMS_CONTENT_PACK_HPP
+#define CMS_CONTENT_PACK_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "content.hpp"
+#include "contentStore.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace cms {
+
+/**
+ * Content pack: one immutable file holding the modes, layouts, pages and
+ * posts of every database, served by mmap without a database.
+ *
+ * Layout (little-endian, 8-byte aligned tables, offsets from file start):
+ *   PackHeader
+ *   string bytes, streamed in as documents are exported
+ *   PackDatabase[databaseCount]
+ *   PackCollection[collectionCount] per database
+ *   PackRecord[recordCount] per collection, sorted by id
+ *
+ * Lookups binary search the record table and return views into the mapping,
+ * so serving a document allocates nothing.
+ */
+constexpr std::array<char, 8> kPackMagic{'C', 'M', 'S', 'P', 'A', 'C', 'K', 0};
+constexpr uint32_t kPackVersion = 2;
+constexpr uint32_t kPackFlagRenderedHtml = 1;
+
+struct PackString {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct PackHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t flags;
+  uint64_t databaseCount;
+  uint64_t databasesOffset;
+};
+
+struct PackDatabase {
+  PackString name;
+  uint64_t collectionCount;
+  uint64_t collectionsOffset;
+};
+
+struct PackCollection {
+  PackString name;
+  uint64_t recordCount;
+  uint64_t recordsOffset;
+};
+
+// One record layout for every collection; unused fields are empty.
+struct PackRecord {
+  PackString id;
+  PackString title;
+  PackString description;
+  PackString content;
+  PackString header;   // layouts
+  PackString footer;   // layouts
+  PackString mode;     // modes
+  PackString rendered; // pages and posts, when exported with HTML
+  int64_t createdAt;
+  int64_t updatedAt;
+  int32_t modeId;
+  int32_t layoutId;
+};
+
+static_assert(sizeof(PackRecord) % 8 == 0, "PackRecord must stay aligned");
+
+// Read-only ContentStore over a memory-mapped content pack.
+class ContentPackStore : public ContentStore {
+public:
+  explicit ContentPackStore(const string &packPath);
+  ~ContentPackStore() override;
+
+  ContentPackStore(const ContentPackStore &) = delete;
+  ContentPackStore &operator=(const ContentPackStore &) = delete;
+
+  std::optional<ContentDocument>
+  getDocument(std::string_view dbName, std::string_view collectionName,
+              const ContentIdType &idType, std::string_view idValue) override;
+
+  std::optional<ContentLayout> getLayout(std::string_view dbName,
+                                         int layoutId) override;
+
+  std::optional<string> getMode(std::string_view dbName, int modeId) override;
+
+  std::vector<string> listIds(std::string_view dbName,
+                              std::string_view collectionName) override;
+
+private:
+  template <typename T> const T *table(uint64_t offset, uint64_t count) const;
+  std::string_view text(const PackString &value) const;
+  void validate() const;
+
+  const PackCollection *findCollection(std::string_view dbName,
+                                       std::string_view collectionName) const;
+  const PackRecord *findRecord(std::string_view dbName,
+                               std::string_view collectionName,
+                               std::string_view idValue) const;
+  const PackRecord *findRecord(std::string_view dbName,
+                               std::string_view collectionName,
+                               int idValue) const;
+
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  const PackHeader *header = nullptr;
+};
+
+ContentPackStore::ContentPackStore(const string &packPath) {
+  int fd = open(packPath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw std::runtime_error("Unable to open content pack " + packPath + ": " +
+                             std::strerror(errno));
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) == -1) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error("Unable to stat content pack " + packPath + ": " +
+                             std::strerror(error));
+  }
+  size = static_cast<size_t>(fileStat.st_size);
+  if (size < sizeof(PackHeader)) {
+    close(fd);
+    throw std::runtime_error("Invalid content pack " + packPath);
+  }
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Unable to map content pack " + packPath + ": " +
+                             std::strerror(errno));
+  }
+  data = static_cast<const uint8_t *>(mapping);
+  header = reinterpret_cast<const PackHeader *>(data);
+
+  try {
+    validate();
+  } catch (...) {
+    munmap(const_cast<uint8_t *>(data), size);
+    throw;
+  }
+}
+
+ContentPackStore::~ContentPackStore() {
+  munmap(const_cast<uint8_t *>(data), size);
+}
+
+template <typename T>
+const T *ContentPackStore::table(uint64_t offset, uint64_t count) const {
+  if (offset % alignof(T) != 0 || offset > size ||
+      count > (size - offset) / sizeof(T)) {
+    throw std::runtime_error("Corrupt content pack table");
+  }
+  return reinterpret_cast<const T *>(data + offset);
+}
+
+std::string_view ContentPackStore::text(const PackString &value) const {
+  return std::string_view(reinterpret_cast<const char *>(data) + value.offset,
+                          value.size);
+}
+
+// Check every table and string reference once so lookups can trust them.
+void ContentPackStore::validate() const {
+  if (header->magic != kPackMagic || header->version != kPackVersion) {
+    throw std::runtime_error("Unsupported content pack format");
+  }
+  auto checkString = [this](const PackString &value) {
+    if (value.offset > size || value.size > size - value.offset) {
+      throw std::runtime_error("Corrupt content pack string");
+    }
+  };
+  const auto *databases =
+      table<PackDatabase>(header->databasesOffset, header->databaseCount);
+  for (uint64_t i = 0; i < header->databaseCount; ++i) {
+    checkString(databases[i].name);
+    const auto *collections = table<PackCollection>(
+        databases[i].collectionsOffset, databases[i].collectionCount);
+    for (uint64_t j = 0; j < databases[i].collectionCount; ++j) {
+      checkString(collections[j].name);
+      const auto *records = table<PackRecord>(collections[j].recordsOffset,
+                                              collections[j].recordCount);
+      for (uint64_t k = 0; k < collections[j].recordCount; ++k) {
+        for (const auto *value :
+             {&records[k].id, &records[k].title, &records[k].description,
+              &records[k].content,
+              &records[k].header, &records[k].footer, &records[k].mode,
+              &records[k].rendered}) {
+          checkString(*value);
+        }
+      }
+    }
+  }
+}
+
+const PackCollection *
+ContentPackStore::findCollection(std::string_view dbName,
+                                 std::string_view collectionName) const {
+  // A handful of databases with four collections each: scan linearly.
+  const auto *databases =
+      table<PackDatabase>(header->databasesOffset, header->databaseCount);
+  for (uint64_t i = 0; i < header->databaseCount; ++i) {
+    if (text(databases[i].name) != dbName) {
+      continue;
+    }
+    const auto *collections = table<PackCollection>(
+        databases[i].collectionsOffset, databases[i].collectionCount);
+    for (uint64_t j = 0; j < databases[i].collectionCount; ++j) {
+      if (text(collections[j].name) == collectionName) {
+        return &collections[j];
+      }
+    }
+  }
+  return nullptr;
+}
+
+const PackRecord *
+ContentPackStore::findRecord(std::string_view dbName,
+                             std::string_view collectionName,
+                             std::string_view idValue) const {
+  const auto *collection = findCollection(dbName, collectionName);
+  if (collection == nullptr) {
+    return nullptr;
+  }
+  const auto *begin =
+      table<PackRecord>(collection->recordsOffset, collection->recordCount);
+  const auto *end = begin + collection->recordCount;
+  const auto *found = std::lower_bound(
+      begin, end, idValue, [this](const PackRecord &record, std::string_view id) {
+        return text(record.id) < id;
+      });
+  if (found == end || text(found->id) != idValue) {
+    return nullptr;
+  }
+  return found;
+}
+
+const PackRecord *
+ContentPackStore::findRecord(std::string_view dbName,
+                             std::string_view collectionName,
+                             int idValue) const {
+  std::array<char, 16> buffer;
+  auto [ptr, ec] =
+      std::to_chars(buffer.data(), buffer.data() + buffer.size(), idValue);
+  return findRecord(dbName, collectionName,
+                    std::string_view(buffer.data(), ptr - buffer.data()));
+}
+
+std::optional<ContentDocument>
+ContentPackStore::getDocument(std::string_view dbName,
+                              std::string_view collectionName,
+                              const ContentIdType &idType,
+                              std::string_view idValue) {
+  // Both id types are keyed by their string form.
+  (void)idType;
+
+  const auto *record = findRecord(dbName, collectionName, idValue);
+  if (record == nullptr) {
+    return std::nullopt;
+  }
+  // Same join semantics as the MongoDB $lookup/$unwind pipeline: a
+  // document without its mode or layout is not found.
+  if (findRecord(dbName, "modes", record->modeId) == nullptr) {
+    return std::nullopt;
+  }
+  const auto *layout = findRecord(dbName, "layouts", record->layoutId);
+  if (layout == nullptr) {
+    return std::nullopt;
+  }
+
+  ContentDocument document;
+  document.title = text(record->title);
+  document.description = text(record->description);
+  document.content = text(record->content);
+  document.modeId = record->modeId;
+  document.layoutId = record->layoutId;
+  document.createdAt = record->createdAt;
+  document.updatedAt = record->updatedAt;
+  document.header = text(layout->header);
+  document.footer = text(layout->footer);
+  document.layoutUpdatedAt = layout->updatedAt;
+  document.rendered = text(record->rendered);
+  return document;
+}
+
+std::optional<ContentLayout>
+ContentPackStore::getLayout(std::string_view dbName, int layoutId) {
+  const auto *layout = findRecord(dbName, "layouts", layoutId);
+  if (layout == nullptr) {
+    return std::nullopt;
+  }
+  ContentLayout result;
+  result.id = layoutId;
+  result.header = text(layout->header);
+  result.footer = text(layout->footer);
+  result.updatedAt = layout->updatedAt;
+  return result;
+}
+
+std::optional<string> ContentPackStore::getMode(std::string_view dbName,
+                                                int modeId) {
+  const auto *mode = findRecord(dbName, "modes", modeId);
+  if (mode == nullptr) {
+    return std::nullopt;
+  }
+  return string(text(mode->mode));
+}
+
+std::vector<string>
+ContentPackStore::listIds(std::string_view dbName,
+                          std::string_view collectionName) {
+  std::vector<string> ids;
+  const auto *collection = findCollection(dbName, collectionName);
+  if (collection == nullptr) {
+    return ids;
+  }
+  const auto *records =
+      table<PackRecord>(collection->recordsOffset, collection->recordCount);
+  ids.reserve(collection->recordCount);
+  for (uint64_t i = 0; i < collection->recordCount; ++i) {
+    ids.emplace_back(text(records[i].id));
+  }
+  return ids;
+}
+
+/**
+ * Streams the content of a store into a pack file. Strings are appended to
+ * the file as each document is fetched; only the fixed-size record tables
+ * are held in memory until the end.
+ */
+class ContentPackWriter {
+public:
+  struct Result {
+    size_t documents = 0;
+    size_t bytes = 0;
+  };
+
+  // With a renderer, pages and posts also carry their rendered HTML.
+  static Result write(ContentStore &store, const Content *renderer,
+                      const std::vector<std::string_view> &databases,
+                      const string &packPath);
+
+private:
+  explicit ContentPackWriter(const string &filePath);
+  ~ContentPackWriter();
+
+  // Append the databases' strings, then the record tables and header.
+  Result writeContent(ContentStore &store, const Content *renderer,
+                      const std::vector<std::string_view> &databases);
+
+  PackString append(std::string_view value);
+  uint64_t alignTo8();
+  void writeAt(uint64_t offset, const void *value, size_t length);
+  void finish();
+
+  struct PendingCollection {
+    PackString name;
+    std::vector<std::pair<string, PackRecord>> records;
+  };
+  struct PendingDatabase {
+    PackString name;
+    std::vector<PendingCollection> collections;
+  };
+
+  std::FILE *file = nullptr;
+  uint64_t offset = 0;
+};
+
+ContentPackWriter::ContentPackWriter(const string &filePath) {
+  file = std::fopen(filePath.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Unable to create " + filePath + ": " +
+                             std::strerror(errno));
+  }
+  PackHeader placeholder{};
+  writeAt(0, &placeholder, sizeof(placeholder));
+}
+
+ContentPackWriter::~ContentPackWriter() {
+  if (file != nullptr) {
+    std::fclose(file);
+  }
+}
+
+void ContentPackWriter::writeAt(uint64_t position, const void *value,
+                                size_t length) {
+  // Any failure throws, so write() removes the partial file.
+  auto seek = [this](uint64_t to) {
+    if (std::fseek(file, static_cast<long>(to), SEEK_SET) != 0) {
+      throw std::runtime_error(string("Unable to seek in content pack: ") +
+                               std::strerror(errno));
+    }
+  };
+  if (position != offset) {
+    seek(position);
+  }
+  if (length > 0 && std::fwrite(value, 1, length, file) != length) {
+    throw std::runtime_error(string("Unable to write content pack: ") +
+                             std::strerror(errno));
+  }
+  if (position != offset) {
+    seek(offset);
+  } else {
+    offset += length;
+  }
+}
+
+PackString ContentPackWriter::append(std::string_view value) {
+  PackString result{offset, value.size()};
+  writeAt(offset, value.data(), value.size());
+  return result;
+}
+
+uint64_t ContentPackWriter::alignTo8() {
+  static constexpr std::array<char, 8> kPadding{};
+  writeAt(offset, kPadding.data(), (8 - offset % 8) % 8);
+  return offset;
+}
+
+void ContentPackWriter::finish() {
+  if (std::fflush(file) != 0 || fsync(fileno(file)) != 0) {
+    throw std::runtime_error("Unable to flush content pack");
+  }
+  auto closed = std::fclose(file);
+  file = nullptr;
+  if (closed != 0) {
+    throw std::runtime_error("Unable to close content pack");
+  }
+}
+
+ContentPackWriter::Result
+ContentPackWriter::write(ContentStore &store, const Content *renderer,
+                         const std::vector<std::string_view> &databases,
+                         const string &packPath) {
+  // Write next to the target and rename, so a served pack is never partial.
+  string temporaryPath = packPath + ".tmp";
+  try {
+    ContentPackWriter writer(temporaryPath);
+    auto result = writer.writeContent(store, renderer, databases);
+    writer.finish();
+    std::filesystem::rename(temporaryPath, packPath);
+    return result;
+  } catch (...) {
+    std::error_code ec;
+    std::filesystem::remove(temporaryPath, ec);
+    throw;
+  }
+}
+
+ContentPackWriter::Result
+ContentPackWriter::writeContent(
+    ContentStore &store, const Content *renderer,
+    const std::vector<std::string_view> &databases) {
+  const std::array<std::string_view, 4> kCollections{"modes", "layouts",
+                                                     "pages", "posts"};
+  Result result;
+
+  std::vector<PendingDatabase> pending;
+  for (auto dbName : databases) {
+    auto &database = pending.emplace_back();
+    database.name = append(dbName);
+
+    for (auto collectionName : kCollections) {
+      auto &collection = database.collections.emplace_back();
+      collection.name = append(collectionName);
+
+      for (auto &id : store.listIds(dbName, collectionName)) {
+        PackRecord record{};
+        record.id = append(id);
+
+        if (collectionName == "modes") {
+          int modeId = 0;
+          std::from_chars(id.data(), id.data() + id.size(), modeId);
+          auto mode = store.getMode(dbName, modeId);
+          if (!mode) {
+            continue;
+          }
+          record.mode = append(*mode);
+        } else if (collectionName == "layouts") {
+          int layoutId = 0;
+          std::from_chars(id.data(), id.data() + id.size(), layoutId);
+          auto layout = store.getLayout(dbName, layoutId);
+          if (!layout) {
+            continue;
+          }
+          record.header = append(layout->header);
+          record.footer = append(layout->footer);
+          record.updatedAt = layout->updatedAt;
+        } else {
+          auto idType = collectionName == "posts" ? ContentIdType::Integer
+                                                  : ContentIdType::String;
+          auto document = store.getDocument(dbName, collectionName, idType, id);
+          if (!document) {
+            spdlog::warn("Skipping {}.{} ({}) without mode or layout", dbName,
+                         collectionName, id);
+            continue;
+          }
+          record.title = append(document->title);
+          record.description = append(document->description);
+          record.content = append(document->content);
+          record.createdAt = document->createdAt;
+          record.updatedAt = document->updatedAt;
+          record.modeId = document->modeId;
+          record.layoutId = document->layoutId;
+          if (renderer != nullptr) {
+            record.rendered = append(renderer->renderDocument(
+                dbName, contentPath(collectionName, id), *document));
+          }
+        }
+        collection.records.emplace_back(std::move(id), record);
+        ++result.documents;
+      }
+    }
+  }
+
+  // Tables: databases, then each database's collections, then records.
+  alignTo8();
+  uint64_t databasesOffset = offset;
+  uint64_t nextOffset = databasesOffset + pending.size() * sizeof(PackDatabase);
+  std::vector<PackDatabase> databaseTable;
+  for (auto &database : pending) {
+    databaseTable.push_back(PackDatabase{
+        database.name, database.collections.size(), nextOffset});
+    nextOffset += database.collections.size() * sizeof(PackCollection);
+  }
+  writeAt(offset, databaseTable.data(),
+          databaseTable.size() * sizeof(PackDatabase));
+
+  for (auto &database : pending) {
+    std::vector<PackCollection> collectionTable;
+    for (auto &collection : database.collections) {
+      collectionTable.push_back(PackCollection{
+          collection.name, collection.records.size(), nextOffset});
+      nextOffset += collection.records.size() * sizeof(PackRecord);
+    }
+    writeAt(offset, collectionTable.data(),
+            collectionTable.size() * sizeof(PackCollection));
+  }
+
+  for (auto &database : pending) {
+    for (auto &collection : database.collections) {
+      std::sort(collection.records.begin(), collection.records.end(),
+                [](const auto &left, const auto &right) {
+                  return left.first < right.first;
+                });
+      for (const auto &[id, record] : collection.records) {
+        writeAt(offset, &record, sizeof(record));
+      }
+    }
+  }
+
+  PackHeader header{};
+  header.magic = kPackMagic;
+  header.version = kPackVersion;
+  header.flags = renderer != nullptr ? kPackFlagRenderedHtml : 0;
+  header.databaseCount = pending.size();
+  header.databasesOffset = databasesOffset;
+  writeAt(0, &header, sizeof(header));
+
+  result.bytes = offset;
+  return result;
+}
+
+} // namespace cms
+
+#endif // CMS_CONTENT_PACK_HPP
@@ -0,0 +1,207 @@
+#pragma once
+
+#ifndef CMS_CONTENT_STORE_HPP
+#define CMS_CONTENT_STORE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <bsoncxx/document/element.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/stdx/string_view.hpp>
+#include <bsoncxx/types.hpp>
+
+/***
+###############################################################################
+# Constants
+###############################################################################
+***/
+#include "include/constants.h"
+
+namespace cms {
+using string = std::string;
+
+constexpr std::string_view kDocumentIdField{"id"};
+constexpr std::string_view kDocumentModeIdField{"modeId"};
+constexpr std::string_view kDocumentLayoutIdField{"layoutId"};
+constexpr std::string_view kDocumentTitleField{"title"};
+constexpr std::string_view kDocumentDescriptionField{"description"};
+constexpr std::string_view kDocumentContentField{"content"};
+constexpr std::string_view kDocumentCreatedAtField{"createdAt"};
+constexpr std::string_view kDocumentUpdatedAtField{"updatedAt"};
+constexpr std::string_view kDocumentRenderedHtmlField{"renderedHtml"};
+constexpr std::string_view kDocumentRenderedHashField{"renderedHash"};
+constexpr std::string_view kLayoutHeaderField{"header"};
+constexpr std::string_view kLayoutFooterField{"footer"};
+constexpr std::string_view kModeNameField{"mode"};
+
+/**
+ * A post or page joined with its layout. The views point into storage kept
+ * alive by `owner`; backends that outlive every document (memory-mapped
+ * files) leave it empty.
+ */
+struct ContentDocument {
+  std::shared_ptr<const void> owner;
+  std::string_view title;
+  std::string_view description;
+  std::string_view content;
+  int modeId = MODE_HTML;
+  int layoutId = 0;
+  int64_t createdAt = 0; // milliseconds since epoch
+  int64_t updatedAt = 0; // milliseconds since epoch
+  std::string_view header;
+  std::string_view footer;
+  int64_t layoutUpdatedAt = 0; // version of the layout, 0 when unknown
+  // Markdown content rendered at write time, valid while renderedHash
+  // equals markdownHash(content).
+  std::string_view renderedHtml;
+  uint64_t renderedHash = 0;
+  // Full page rendered ahead of time, when the store carries one.
+  std::string_view rendered;
+};
+
+struct ContentLayout {
+  std::shared_ptr<const void> owner;
+  int id = 0;
+  std::string_view header;
+  std::string_view footer;
+  int64_t updatedAt = 0; // milliseconds since epoch, 0 when unknown
+};
+
+/**
+ * Read access to the posts, pages, layouts and modes of each database.
+ * Implementations must be safe to call from every IO thread and report
+ * backend failures by throwing; a missing document is not an error.
+ */
+class ContentStore {
+public:
+  virtual ~ContentStore() = default;
+
+  // Fetch a document of a collection by id, joined with its layout.
+  virtual std::optional<ContentDocument>
+  getDocument(std::string_view dbName, std::string_view collectionName,
+              const ContentIdType &idType, std::string_view idValue) = 0;
+
+  virtual std::optional<ContentLayout> getLayout(std::string_view dbName,
+                                                 int layoutId) = 0;
+
+  // Name of a content mode, e.g. "markdown".
+  virtual std::optional<string> getMode(std::string_view dbName,
+                                        int modeId) = 0;
+
+  // Ids of every document in a collection, integer ids in decimal.
+  virtual std::vector<string> listIds(std::string_view dbName,
+                                      std::string_view collectionName) = 0;
+
+  // Save rendered markdown on a document; false when the store is read-only.
+  virtual bool storeRenderedHtml(std::string_view /*dbName*/,
+                                 std::string_view /*collectionName*/,
+                                 const ContentIdType & /*idType*/,
+                                 std::string_view /*idValue*/,
+                                 std::string_view /*renderedHtml*/,
+                                 uint64_t /*renderedHash*/) {
+    return false;
+  }
+};
+
+/**
+ * BSON field accessors shared by the BSON-backed stores. Numbers are accepted
+ * as int32, int64 or double since mongosh writes plain numbers as doubles.
+ */
+bsoncxx::document::element bsonField(bsoncxx::document::view document,
+                                     std::string_view key) {
+  return document[bsoncxx::stdx::string_view(key.data(), key.size())];
+}
+
+int64_t bsonInt64(bsoncxx::document::view document, std::string_view key,
+                  int64_t fallback = 0) {
+  auto element = bsonField(document, key);
+  if (!element) {
+    return fallback;
+  }
+  switch (element.type()) {
+  case bsoncxx::type::k_int32:
+    return element.get_int32().value;
+  case bsoncxx::type::k_int64:
+    return element.get_int64().value;
+  case bsoncxx::type::k_double:
+    return static_cast<int64_t>(element.get_double().value);
+  default:
+    return fallback;
+  }
+}
+
+std::string_view bsonString(bsoncxx::document::view document,
+                            std::string_view key) {
+  auto element = bsonField(document, key);
+  if (!element || element.type() != bsoncxx::type::k_string) {
+    return {};
+  }
+  auto value = element.get_string().value;
+  return std::string_view(value.data(), value.size());
+}
+
+int64_t bsonDateMillis(bsoncxx::document::view document,
+                       std::string_view key) {
+  auto element = bsonField(document, key);
+  if (!element || element.type() != bsoncxx::type::k_date) {
+    return 0;
+  }
+  return element.get_date().to_int64();
+}
+
+// Document id as a string; integer ids are formatted in decimal.
+string bsonIdString(bsoncxx::document::view document) {
+  auto element = bsonField(document, kDocumentIdField);
+  if (element && element.type() == bsoncxx::type::k_string) {
+    return string(bsonString(document, kDocumentIdField));
+  }
+  return std::to_string(bsonInt64(document, kDocumentIdField));
+}
+
+ContentDocument makeContentDocument(bsoncxx::document::view document,
+                                    bsoncxx::document::view layout,
+                                    std::shared_ptr<const void> owner) {
+  ContentDocument result;
+  result.owner = std::move(owner);
+  result.title = bsonString(document, kDocumentTitleField);
+  result.description = bsonString(document, kDocumentDescriptionField);
+  result.content = bsonString(document, kDocumentContentField);
+  result.modeId = static_cast<int>(
+      bsonInt64(document, kDocumentModeIdField, MODE_HTML));
+  result.layoutId =
+      static_cast<int>(bsonInt64(document, kDocumentLayoutIdField));
+  result.createdAt = bsonDateMillis(document, kDocumentCreatedAtField);
+  result.updatedAt = bsonDateMillis(document, kDocumentUpdatedAtField);
+  result.renderedHtml = bsonString(document, kDocumentRenderedHtmlField);
+  result.renderedHash = static_cast<uint64_t>(
+      bsonInt64(document, kDocumentRenderedHashField));
+  result.header = bsonString(layout, kLayoutHeaderField);
+  result.footer = bsonString(layout, kLayoutFooterField);
+  result.layoutUpdatedAt = bsonDateMillis(layout, kDocumentUpdatedAtField);
+  return result;
+}
+
+ContentLayout makeContentLayout(bsoncxx::document::view layout,
+                                std::shared_ptr<const void> owner) {
+  ContentLayout result;
+  result.owner = std::move(owner);
+  result.id = static_cast<int>(bsonInt64(layout, kDocumentIdField));
+  result.header = bsonString(layout, kLayoutHeaderField);
+  result.footer = bsonString(layout, kLayoutFooterField);
+  result.updatedAt = bsonDateMillis(layout, kDocumentUpdatedAtField);
+  return result;
+}
+
+} // namespace cms
+
+#endif // CMS_CONTENT_STORE_HPP
@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef CMS_DATE_FORMAT_HPP
+#define CMS_DATE_FORMAT_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+namespace services {
+
+namespace detail {
+
+constexpr std::array<std::string_view, 7> kWeekdays{
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+constexpr std::array<std::string_view, 12> kMonths{
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+constexpr std::array<std::string_view, 12> kMonthNames{
+    "January", "February", "March",     "April",   "May",      "June",
+    "July",    "August",   "September", "October", "November", "December"};
+
+char *writeText(char *out, std::string_view text) {
+  for (char c : text) {
+    *out++ = c;
+  }
+  return out;
+}
+
+char *writeTwoDigits(char *out, int value) {
+  out[0] = static_cast<char>('0' + value / 10);
+  out[1] = static_cast<char>('0' + value % 10);
+  return out + 2;
+}
+
+char *writeYear(char *out, int year) {
+  if (year >= 1000 && year <= 9999) {
+    out = writeTwoDigits(out, year / 100);
+    return writeTwoDigits(out, year % 100);
+  }
+  return std::to_chars(out, out + 11, year).ptr;
+}
+
+} // namespace detail
+
+/**
+ * An HTTP date (RFC 7231 IMF-fixdate), e.g. "Sun, 06 Nov 1994 08:49:37 GMT",
+ * held by value so it can be handed across threads.
+ */
+struct HttpDate {
+  static constexpr size_t kSize = 29;
+
+  std::array<char, kSize> text{};
+
+  std::string_view view() const { return {text.data(), text.size()}; }
+};
+
+// Formatted with gmtime_r and hand-written digits; years outside 1000-9999
+// are not representable in the fixed-width format and are clamped.
+HttpDate formatHttpDate(std::time_t time) {
+  std::tm parts{};
+  gmtime_r(&time, &parts);
+  int year = std::clamp(parts.tm_year + 1900, 1000, 9999);
+  HttpDate date;
+  char *out = date.text.data();
+  out = detail::writeText(out, detail::kWeekdays[parts.tm_wday]);
+  out = detail::writeText(out, ", ");
+  out = detail::writeTwoDigits(out, parts.tm_mday);
+  *out++ = ' ';
+  out = detail::writeText(out, detail::kMonths[parts.tm_mon]);
+  *out++ = ' ';
+  out = detail::writeYear(out, year);
+  *out++ = ' ';
+  out = detail::writeTwoDigits(out, parts.tm_hour);
+  *out++ = ':';
+  out = detail::writeTwoDigits(out, parts.tm_min);
+  *out++ = ':';
+  out = detail::writeTwoDigits(out, parts.tm_sec);
+  detail::writeText(out, " GMT");
+  return date;
+}
+
+/**
+ * A content date as shown on pages, e.g. "Thu, June 12, 2025 at 10:33 AM
+ * UTC", from milliseconds since the epoch. Returns the length written; out
+ * needs kContentDateMaxSize bytes.
+ */
+constexpr size_t kContentDateMaxSize = 48;
+
+size_t formatContentDate(int64_t millis, char *out) {
+  auto seconds = static_cast<std::time_t>(
+      millis >= 0 ? millis / 1000 : (millis - 999) / 1000);
+  std::tm parts{};
+  gmtime_r(&seconds, &parts);
+  int hour12 = parts.tm_hour % 12 == 0 ? 12 : parts.tm_hour % 12;
+  char *start = out;
+  out = detail::writeText(out, detail::kWeekdays[parts.tm_wday]);
+  out = detail::writeText(out, ", ");
+  out = detail::writeText(out, detail::kMonthNames[parts.tm_mon]);
+  *out++ = ' ';
+  out = detail::writeTwoDigits(out, parts.tm_mday);
+  out = detail::writeText(out, ", ");
+  out = detail::writeYear(out, parts.tm_year + 1900);
+  out = detail::writeText(out, " at ");
+  out = detail::writeTwoDigits(out, hour12);
+  *out++ = ':';
+  out = detail::writeTwoDigits(out, parts.tm_min);
+  out = detail::writeText(out, parts.tm_hour < 12 ? " AM UTC" : " PM UTC");
+  return static_cast<size_t>(out - start);
+}
+
+/**
+ * formatContentDate behind a small per-thread LRU keyed by minute, the
+ * format's resolution: a page's date is formatted once per thread rather
+ * than on every render. The view stays valid until the thread's next call.
+ */
+class ContentDateCache {
+public:
+  static constexpr size_t kEntries = 32;
+
+  static std::string_view format(int64_t millis);
+
+private:
+  struct Entry {
+    int64_t minute = INT64_MIN;
+    uint64_t used = 0;
+    uint8_t size = 0;
+    std::array<char, kContentDateMaxSize> text;
+  };
+};
+
+std::string_view ContentDateCache::format(int64_t millis) {
+  thread_local std::array<Entry, kEntries> entries;
+  thread_local uint64_t uses = 0;
+  int64_t minute = millis >= 0 ? millis / 60000 : (millis - 59999) / 60000;
+  Entry *oldest = &entries[0];
+  for (auto &entry : entries) {
+    if (entry.minute == minute) {
+      entry.used = ++uses;
+      return {entry.text.data(), entry.size};
+    }
+    if (entry.used < oldest->used) {
+      oldest = &entry;
+    }
+  }
+  oldest->minute = minute;
+  oldest->used = ++uses;
+  oldest->size =
+      static_cast<uint8_t>(formatContentDate(millis, oldest->text.data()));
+  return {oldest->text.data(), oldest->size};
+}
+
+} // namespace services
+
+#endif // CMS_DATE_FORMAT_HPP
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef CMS_DATE_SERVICE_HPP
+#define CMS_DATE_SERVICE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "dateFormat.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace services {
+
+/**
+ * The current Date header value. Once started, a timer on the server's
+ * io_context reformats it at every second boundary into the idle one of two
+ * buffers and then publishes it, so responses only copy 29 bytes. Before
+ * start (tools, benchmarks) it is formatted on each call.
+ */
+class HttpDateClock {
+public:
+  static HttpDateClock &instance();
+
+  // Called once from the thread that sets up the io_context.
+  void start(boost::asio::io_context &ioc);
+
+  HttpDate now() const;
+
+private:
+  void tick();
+
+  std::array<HttpDate, 2> dates;
+  std::atomic<unsigned> active{0};
+  std::atomic<bool> running{false};
+  std::unique_ptr<boost::asio::steady_timer> timer;
+};
+
+HttpDateClock &HttpDateClock::instance() {
+  static HttpDateClock clock;
+  return clock;
+}
+
+void HttpDateClock::start(boost::asio::io_context &ioc) {
+  if (timer) {
+    return;
+  }
+  timer = std::make_unique<boost::asio::steady_timer>(ioc);
+  // The first date is published before readers may switch to the buffers.
+  tick();
+  running.store(true, std::memory_order_release);
+}
+
+HttpDate HttpDateClock::now() const {
+  if (!running.load(std::memory_order_acquire)) {
+    return formatHttpDate(std::time(nullptr));
+  }
+  return dates[active.load(std::memory_order_acquire)];
+}
+
+void HttpDateClock::tick() {
+  auto now = std::chrono::system_clock::now();
+  unsigned idle = active.load(std::memory_order_relaxed) ^ 1u;
+  dates[idle] = formatHttpDate(std::chrono::system_clock::to_time_t(now));
+  active.store(idle, std::memory_order_release);
+
+  // Wake just after the next second boundary.
+  auto sinceSecond = now.time_since_epoch() % std::chrono::seconds(1);
+  timer->expires_after(std::chrono::seconds(1) - sinceSecond +
+                       std::chrono::milliseconds(1));
+  timer->async_wait([this](const boost::system::error_code &ec) {
+    if (!ec) {
+      tick();
+    }
+  });
+}
+
+} // namespace services
+
+#endif // CMS_DATE_SERVICE_HPP
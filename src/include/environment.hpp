@@ -3,16 +3,28 @@
 #ifndef CMS_ENVIRONMENT_HPP
 #define CMS_ENVIRONMENT_HPP
 
+#include <algorithm>
 #include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+
+#include <pthread.h>
+#include <sched.h>
 #include <sys/sysinfo.h>
 #include <sys/utsname.h>
-#include <unordered_set>
 
 #include <boost/optional.hpp>
 #include <spdlog/spdlog.h>
@@ -22,16 +34,40 @@ using string = std::string;
 
 class Environment {
 public:
+  // CPU and memory limits of the process's cgroup, as a container runtime
+  // sets them; none where unlimited.
+  struct CgroupLimits {
+    boost::optional<double> cpuQuota; // in CPUs, e.g. 1.5
+    boost::optional<uint64_t> memoryLimit;
+  };
+
   // Retrieves the value of the specified environment variable.
   // Returns boost::optional containing the value if found, or boost::none if
   // not set.
   static boost::optional<string> getVariable(const string &name);
 
-  static void logOSinfo();
+  static void logOSinfo(const CgroupLimits &limits);
+
+  // Limits from cgroup v2, or the v1 cpu and memory controllers. Files
+  // that are missing or do not parse count as unlimited.
+  static CgroupLimits cgroupLimits() noexcept;
+
+  // CPUs the process can use: its affinity mask, capped by the cgroup CPU
+  // quota rounded up. A container limited to 2 CPUs on a 64-core host
+  // gets 2, where hardware_concurrency() would say 64.
+  static unsigned availableCpus(const CgroupLimits &limits);
+
+  // Name the calling thread as shown by top -H and in /proc (15 chars).
+  static void nameThread(const string &name);
 
 private:
   static string formatBytes(uint64_t bytes);
   static void getProcessorInfo();
+  static boost::optional<string>
+  readFirstLine(const std::filesystem::path &path);
+  // The whole of text as a number, or none.
+  template <typename Number>
+  static boost::optional<Number> parseNumber(std::string_view text);
 };
 
 boost::optional<string> Environment::getVariable(const string &name) {
@@ -110,7 +146,148 @@ void Environment::getProcessorInfo() {
                coreCount, threadCount);
 }
 
-void Environment::logOSinfo() {
+boost::optional<string>
+Environment::readFirstLine(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  string line;
+  if (!file.is_open() || !std::getline(file, line)) {
+    return boost::none;
+  }
+  return line;
+}
+
+template <typename Number>
+boost::optional<Number> Environment::parseNumber(std::string_view text) {
+  Number value{};
+  auto end = text.data() + text.size();
+  auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc() || ptr != end) {
+    return boost::none;
+  }
+  return value;
+}
+
+Environment::CgroupLimits Environment::cgroupLimits() noexcept try {
+  CgroupLimits limits;
+  auto tighten = [](auto &limit, auto value) {
+    if (!limit || value < *limit) {
+      limit = value;
+    }
+  };
+
+  // Lines of /proc/self/cgroup are "id:controllers:path"; cgroup v2 has a
+  // single "0::path" line.
+  std::map<string, string> groups;
+  std::ifstream self("/proc/self/cgroup");
+  for (string line; std::getline(self, line);) {
+    auto first = line.find(':');
+    auto second = line.find(':', first + 1);
+    if (first != string::npos && second != string::npos) {
+      groups[line.substr(first + 1, second - first - 1)] =
+          line.substr(second + 1);
+    }
+  }
+
+  // Visit the group's directory and its ancestors up to the hierarchy's
+  // mount point: the limits of every ancestor apply too.
+  auto visitGroup = [](const std::filesystem::path &mount,
+                       const string &group, auto &&visit) {
+    std::error_code ec;
+    auto dir = mount / std::filesystem::path(group).relative_path();
+    while (dir.native().size() > mount.native().size() &&
+           !std::filesystem::exists(dir, ec)) {
+      dir = dir.parent_path(); // group not visible in this mount namespace
+    }
+    for (;;) {
+      visit(dir);
+      if (dir.native().size() <= mount.native().size()) {
+        break;
+      }
+      dir = dir.parent_path();
+    }
+  };
+
+  const std::filesystem::path root("/sys/fs/cgroup");
+  std::error_code ec;
+  if (std::filesystem::exists(root / "cgroup.controllers", ec)) {
+    visitGroup(root, groups[""], [&](const std::filesystem::path &dir) {
+      if (auto cpuMax = readFirstLine(dir / "cpu.max")) {
+        // "<quota|max> <period>"
+        std::string_view fields(*cpuMax);
+        auto space = fields.find(' ');
+        auto quota = parseNumber<double>(fields.substr(0, space));
+        auto period = space == std::string_view::npos
+                          ? boost::none
+                          : parseNumber<double>(fields.substr(space + 1));
+        if (quota && period && *quota > 0 && *period > 0) {
+          tighten(limits.cpuQuota, *quota / *period);
+        }
+      }
+      if (auto memoryMax = readFirstLine(dir / "memory.max")) {
+        if (auto limit = parseNumber<uint64_t>(*memoryMax)) {
+          tighten(limits.memoryLimit, *limit);
+        }
+      }
+    });
+    return limits;
+  }
+
+  // cgroup v1: a quota of -1 and a limit near 2^63 mean unlimited.
+  for (const auto &[controllers, group] : groups) {
+    std::istringstream names(controllers);
+    for (string name; std::getline(names, name, ',');) {
+      if (name == "cpu") {
+        visitGroup(root / controllers, group,
+                   [&](const std::filesystem::path &dir) {
+                     auto quotaLine = readFirstLine(dir / "cpu.cfs_quota_us");
+                     auto periodLine =
+                         readFirstLine(dir / "cpu.cfs_period_us");
+                     auto quota = quotaLine ? parseNumber<double>(*quotaLine)
+                                            : boost::none;
+                     auto period = periodLine
+                                       ? parseNumber<double>(*periodLine)
+                                       : boost::none;
+                     if (quota && period && *quota > 0 && *period > 0) {
+                       tighten(limits.cpuQuota, *quota / *period);
+                     }
+                   });
+      } else if (name == "memory") {
+        visitGroup(root / controllers, group,
+                   [&](const std::filesystem::path &dir) {
+                     auto line = readFirstLine(dir / "memory.limit_in_bytes");
+                     auto limit =
+                         line ? parseNumber<uint64_t>(*line) : boost::none;
+                     if (limit && *limit < (uint64_t{1} << 62)) {
+                       tighten(limits.memoryLimit, *limit);
+                     }
+                   });
+      }
+    }
+  }
+  return limits;
+} catch (const std::exception &e) {
+  // Filesystem errors or allocation failure: treat as unlimited.
+  spdlog::warn("Unable to read cgroup limits: {}", e.what());
+  return {};
+}
+
+unsigned Environment::availableCpus(const CgroupLimits &limits) {
+  unsigned cpus = std::thread::hardware_concurrency();
+  cpu_set_t affinity;
+  if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0) {
+    cpus = static_cast<unsigned>(CPU_COUNT(&affinity));
+  }
+  if (limits.cpuQuota) {
+    cpus = std::min(cpus, static_cast<unsigned>(std::ceil(*limits.cpuQuota)));
+  }
+  return std::max(1u, cpus);
+}
+
+void Environment::nameThread(const string &name) {
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+void Environment::logOSinfo(const CgroupLimits &limits) {
   struct utsname info;
   if (uname(&info) == -1) {
     spdlog::error("OS info error: ", std::strerror(errno));
@@ -130,6 +307,14 @@ void Environment::logOSinfo() {
   }
 
   getProcessorInfo();
+
+  if (limits.cpuQuota || limits.memoryLimit) {
+    spdlog::info("cgroup limits: CPU {}, memory {}",
+                 limits.cpuQuota ? fmt::format("{:.2f}", *limits.cpuQuota)
+                                 : "unlimited",
+                 limits.memoryLimit ? formatBytes(*limits.memoryLimit)
+                                    : "unlimited");
+  }
 }
 } // namespace cms
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef CMS_FRAGMENT_BODY_HPP
+#define CMS_FRAGMENT_BODY_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "layoutTemplate.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+namespace cms {
+
+/**
+ * Beast response body over a RenderedPage. The serializer receives every
+ * piece as one buffer sequence, which the socket sends with a single
+ * gathered write (sendmsg/writev) instead of copying the page together.
+ */
+struct FragmentBody {
+  using value_type = RenderedPage;
+
+  static std::uint64_t size(const value_type &body) { return body.size; }
+
+  class writer {
+  public:
+    using const_buffers_type = std::vector<boost::asio::const_buffer>;
+
+    template <bool isRequest, class Fields>
+    writer(const boost::beast::http::header<isRequest, Fields> &,
+           const value_type &body)
+        : body_(body) {}
+
+    void init(boost::beast::error_code &ec) { ec = {}; }
+
+    boost::optional<std::pair<const_buffers_type, bool>>
+    get(boost::beast::error_code &ec) {
+      ec = {};
+      if (done_) {
+        return boost::none;
+      }
+      done_ = true;
+      const_buffers_type buffers;
+      buffers.reserve(body_.pieces.size());
+      for (auto piece : body_.pieces) {
+        buffers.emplace_back(piece.data(), piece.size());
+      }
+      return std::make_pair(std::move(buffers), false);
+    }
+
+  private:
+    const value_type &body_;
+    bool done_ = false;
+  };
+};
+
+} // namespace cms
+
+#endif // CMS_FRAGMENT_BODY_HPP
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef CMS_HTML_ESCAPE_HPP
+#define CMS_HTML_ESCAPE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "byteSearch.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace cms {
+
+namespace detail {
+
+constexpr std::string_view kHtmlSpecials = "&<>\"'";
+
+constexpr bool isHtmlSpecial(char byte) {
+  return byte == '&' || byte == '<' || byte == '>' || byte == '"' ||
+         byte == '\'';
+}
+
+constexpr std::string_view htmlEntity(char byte) {
+  switch (byte) {
+  case '&':
+    return "&amp;";
+  case '<':
+    return "&lt;";
+  case '>':
+    return "&gt;";
+  case '"':
+    return "&quot;";
+  default:
+    return "&#39;";
+  }
+}
+
+} // namespace detail
+
+/**
+ * Offset of the first byte of text at or after pos that HTML-escaping would
+ * change, or text.size(). Searched a vector at a time by findAnyByte, so
+ * text with nothing to escape is passed over at close to memory bandwidth.
+ */
+size_t findHtmlSpecial(std::string_view text, size_t pos = 0) {
+  return findAnyByte<detail::kHtmlSpecials.size()>(
+      text, detail::kHtmlSpecials.data(), pos);
+}
+
+/**
+ * Append text to out with & < > " ' replaced by entities, which makes it
+ * safe in element content and quoted attribute values alike. Text with
+ * nothing to escape is appended with a single copy.
+ */
+template <typename String>
+void appendHtmlEscaped(std::string_view text, String &out) {
+  size_t special = findHtmlSpecial(text);
+  if (special == text.size()) {
+    out.append(text);
+    return;
+  }
+  size_t escapedSize = text.size();
+  for (size_t i = special; i < text.size(); i = findHtmlSpecial(text, i + 1)) {
+    escapedSize += detail::htmlEntity(text[i]).size() - 1;
+  }
+  out.reserve(out.size() + escapedSize);
+  size_t start = 0;
+  while (special < text.size()) {
+    out.append(text.substr(start, special - start));
+    out.append(detail::htmlEntity(text[special]));
+    start = special + 1;
+    special = findHtmlSpecial(text, start);
+  }
+  out.append(text.substr(start));
+}
+
+std::string htmlEscape(std::string_view text) {
+  std::string escaped;
+  appendHtmlEscaped(text, escaped);
+  return escaped;
+}
+
+} // namespace cms
+
+#endif // CMS_HTML_ESCAPE_HPP
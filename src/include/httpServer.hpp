@@ -11,15 +11,27 @@
 
 #include <spdlog/spdlog.h>
 
+#include "include/fragmentBody.hpp"
+#include "include/accessLog.hpp"
+#include "include/dateService.hpp"
+#include "include/htmlEscape.hpp"
+#include "include/ioWatchdog.hpp"
+#include "include/metrics.hpp"
 #include "include/page.hpp"
 #include "include/post.hpp"
+#include "include/requestTrace.hpp"
+#include "include/trafficCapture.hpp"
 
 #include <algorithm>
+#include <array>
 #include <charconv>
+#include <chrono>
 #include <cstdlib>
+#include <ctime>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <system_error>
 #include <thread>
@@ -27,6 +39,7 @@
 
 #include <boost/asio/coroutine.hpp>
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -35,8 +48,12 @@
 #include <boost/url.hpp>
 #include <bsoncxx/stdx/string_view.hpp>
 
+#include <sys/stat.h>
+
 constexpr bsoncxx::stdx::string_view LOCALHOST_DB{"localhost"};
 constexpr bsoncxx::stdx::string_view QUIZBIN_DB{"quizbin"};
+constexpr std::array<bsoncxx::stdx::string_view, 2> CONTENT_DATABASES{
+    LOCALHOST_DB, QUIZBIN_DB};
 
 namespace beast = boost::beast;   // from <boost/beast.hpp>
 namespace http = beast::http;     // from <boost/beast/http.hpp>
@@ -97,6 +114,25 @@ beast::string_view mime_type(beast::string_view path) {
   return "application/text";
 }
 
+// Value of the Date header, refreshed once a second by HttpDateClock.
+services::HttpDate http_date() {
+  return services::HttpDateClock::instance().now();
+}
+
+// How long clients and proxies may reuse a static file without asking.
+constexpr std::chrono::seconds static_max_age{3600};
+
+// Cache-Control max-age for a static file, with the matching Expires for
+// HTTP/1.0 caches, which ignore Cache-Control.
+template <class Response> void set_static_freshness(Response &res) {
+  static const std::string cache_control =
+      "public, max-age=" + std::to_string(static_max_age.count());
+  res.set(http::field::cache_control, cache_control);
+  res.set(http::field::expires,
+          services::formatHttpDate(std::time(nullptr) + static_max_age.count())
+              .view());
+}
+
 // Append an HTTP rel-path to a local filesystem path.
 // The returned path is normalized for the platform.
 std::string path_cat(beast::string_view base, beast::string_view path) {
@@ -120,59 +156,252 @@ std::string path_cat(beast::string_view base, beast::string_view path) {
   return result;
 }
 
+// The page or post a request target addresses.
+struct content_route {
+  enum class kind { none, page, post, not_found, url_error };
+  kind type = kind::none;
+  bsoncxx::stdx::string_view dbName = LOCALHOST_DB;
+  std::string pageId;
+  int postId = NONE_POST_ID;
+};
+
+content_route route_content(std::string_view host, beast::string_view target) {
+  content_route route;
+  if (host.find("quizbin.com") != beast::string_view::npos) {
+    route.dbName = QUIZBIN_DB;
+  }
+
+  std::string urlRequest{"http://"};
+  urlRequest.append(host);
+  urlRequest.append(target);
+  boost::system::result<boost::urls::url_view> urlResult =
+      boost::urls::parse_uri(urlRequest);
+
+  if (!urlResult.has_value() || urlResult.has_error()) {
+    route.type = content_route::kind::url_error;
+    return route;
+  }
+
+  boost::urls::url_view urlView = urlResult.value();
+  auto segments = urlView.segments();
+
+  if (segments.size() == 0) {
+    // Handle the index route (/)
+    route.type = content_route::kind::page;
+    route.pageId = "index";
+  } else if (segments.size() == 1 && target == "/about") {
+    route.type = content_route::kind::page;
+    route.pageId = "about";
+  } else if (target.find("/posts/") != beast::string_view::npos) {
+    route.type = content_route::kind::not_found;
+    if (segments.size() >= 2) {
+      long unsigned int index = 0;
+      const long unsigned int lastSegment = segments.size() - 1;
+      for (const auto &segment : segments) {
+        if (index == lastSegment) {
+          // Converts string segment to int with numeric validation
+          auto [ptr, ec] = std::from_chars(
+              segment.data(), segment.data() + segment.size(), route.postId);
+          if (ec != std::errc() || ptr != segment.data() + segment.size()) {
+            route.postId = NONE_POST_ID;
+          }
+          break;
+        } else if (index > MAX_POST_URL_SEGMENTS) {
+          break;
+        }
+        ++index;
+      }
+      if (route.postId > NONE_POST_ID) {
+        route.type = content_route::kind::post;
+      }
+    }
+  }
+  return route;
+}
+
+// Where a request was routed, for the request metrics.
+enum class request_route : uint8_t { page, post, static_file, metrics, other };
+
+constexpr std::array<std::string_view, 5> request_route_names{
+    "page", "post", "static", "metrics", "other"};
+
+// What handle_request did with a request.
+struct request_outcome {
+  request_route route = request_route::other;
+  unsigned status = 0;
+};
+
+// Request metrics of all sessions. Recording only touches the calling
+// thread's shards; they are summed when the metrics endpoint is scraped.
+class http_metrics {
+public:
+  static http_metrics &instance();
+
+  void record(const request_outcome &outcome, std::size_t bytes_in,
+              std::size_t bytes_out,
+              std::chrono::steady_clock::duration elapsed);
+
+  void session_opened() {
+    sessions_.add();
+    active_sessions_.add(1);
+  }
+  void session_closed() { active_sessions_.add(-1); }
+
+  void write_prometheus(std::string &out) const;
+
+private:
+  static constexpr std::size_t status_classes = 5; // 1xx to 5xx
+
+  std::array<services::Counter,
+             request_route_names.size() * status_classes>
+      requests_;
+  std::array<services::ShardedHistogram, request_route_names.size()>
+      durations_;
+  services::Counter bytes_in_;
+  services::Counter bytes_out_;
+  services::Counter sessions_;
+  services::Gauge active_sessions_;
+};
+
+http_metrics &http_metrics::instance() {
+  static http_metrics metrics;
+  return metrics;
+}
+
+void http_metrics::record(const request_outcome &outcome,
+                          std::size_t bytes_in, std::size_t bytes_out,
+                          std::chrono::steady_clock::duration elapsed) {
+  auto const route = static_cast<std::size_t>(outcome.route);
+  auto const status_class =
+      std::clamp<std::size_t>(outcome.status / 100, 1, status_classes) - 1;
+  requests_[route * status_classes + status_class].add();
+  durations_[route].record(elapsed);
+  bytes_in_.add(bytes_in);
+  bytes_out_.add(bytes_out);
+}
+
+void http_metrics::write_prometheus(std::string &out) const {
+  services::writeMetricHeader(out, "cms_http_requests_total", "counter",
+                              "Requests answered, by route and status class.");
+  for (std::size_t route = 0; route < request_route_names.size(); ++route) {
+    for (std::size_t status = 0; status < status_classes; ++status) {
+      auto labels = fmt::format("route=\"{}\",code=\"{}xx\"",
+                                request_route_names[route], status + 1);
+      services::writeSample(out, "cms_http_requests_total", labels,
+                            requests_[route * status_classes + status].value());
+    }
+  }
+  services::writeMetricHeader(
+      out, "cms_http_request_duration_seconds", "histogram",
+      "Time from reading a request to writing its response.");
+  for (std::size_t route = 0; route < request_route_names.size(); ++route) {
+    auto labels = fmt::format("route=\"{}\"", request_route_names[route]);
+    services::writeHistogram(out, "cms_http_request_duration_seconds", labels,
+                             durations_[route].snapshot());
+  }
+  services::writeMetricHeader(out, "cms_http_received_bytes_total", "counter",
+                              "Request bytes read, headers included.");
+  services::writeSample(out, "cms_http_received_bytes_total", "",
+                        bytes_in_.value());
+  services::writeMetricHeader(out, "cms_http_sent_bytes_total", "counter",
+                              "Response bytes written, headers included.");
+  services::writeSample(out, "cms_http_sent_bytes_total", "",
+                        bytes_out_.value());
+  services::writeMetricHeader(out, "cms_http_sessions_total", "counter",
+                              "Connections accepted.");
+  services::writeSample(out, "cms_http_sessions_total", "",
+                        sessions_.value());
+  services::writeMetricHeader(out, "cms_http_active_sessions", "gauge",
+                              "Connections open.");
+  services::writeSample(
+      out, "cms_http_active_sessions", "",
+      static_cast<uint64_t>(std::max<int64_t>(0, active_sessions_.value())));
+}
+
 // Return a response for the given request.
 //
 // The concrete type of the response message (which depends on the
-// request), is type-erased in message_generator.
+// request), is type-erased in message_generator. The route taken and the
+// status are reported through outcome. Without serve_metrics, METRICS_PATH
+// is not found.
 template <class Body, class Allocator>
 http::message_generator
 handle_request(std::shared_ptr<cms::Post> post, std::shared_ptr<cms::Page> page,
-               beast::string_view doc_root,
+               beast::string_view doc_root, bool serve_metrics,
+               request_outcome &outcome,
                http::request<Body, http::basic_fields<Allocator>> &&req) {
   // Returns a bad request response
-  auto const bad_request = [&req](beast::string_view why) {
+  auto const bad_request = [&req, &outcome](beast::string_view why) {
     http::response<http::string_body> res{http::status::bad_request,
                                           req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
     res.set(http::field::content_type, "text/html");
     res.keep_alive(req.keep_alive());
     res.body() = std::string(why);
     res.prepare_payload();
+    outcome.status = res.result_int();
     return res;
   };
 
   // Returns a not found response
-  auto const not_found = [&req](beast::string_view target) {
+  auto const not_found = [&req, &outcome](beast::string_view target) {
     http::response<http::string_body> res{http::status::not_found,
                                           req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
     res.set(http::field::content_type, "text/html");
     res.keep_alive(req.keep_alive());
-    res.body() = "The resource '" + std::string(target) + "' was not found.";
+    std::string_view resource(target.data(), target.size());
+    res.body() =
+        "The resource '" + cms::htmlEscape(resource) + "' was not found.";
     res.prepare_payload();
+    outcome.status = res.result_int();
     return res;
   };
 
   // Returns a server error response
-  auto const server_error = [&req](beast::string_view what) {
+  auto const server_error = [&req, &outcome](beast::string_view what) {
     http::response<http::string_body> res{http::status::internal_server_error,
                                           req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
     res.set(http::field::content_type, "text/html");
     res.keep_alive(req.keep_alive());
-    res.body() = "An error occurred: '" + std::string(what) + "'";
+    res.body() = "An error occurred: '" +
+                 cms::htmlEscape(std::string_view(what.data(), what.size())) +
+                 "'";
     res.prepare_payload();
+    outcome.status = res.result_int();
     return res;
   };
 
-  // Returns html response
-  auto const html_response = [&req](std::string &response) {
-    http::response<http::string_body> res{http::status::ok, req.version()};
+  // Returns a service unavailable response
+  auto const service_unavailable = [&req,
+                                    &outcome](std::chrono::seconds retryAfter) {
+    http::response<http::string_body> res{http::status::service_unavailable,
+                                          req.version()};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
+    res.set(http::field::content_type, "text/html");
+    res.set(http::field::retry_after, std::to_string(retryAfter.count()));
+    res.keep_alive(req.keep_alive());
+    res.body() = "The service is temporarily unavailable.";
+    res.prepare_payload();
+    outcome.status = res.result_int();
+    return res;
+  };
+
+  // Returns html response, sending the page's fragments without copying
+  auto const html_response = [&req, &outcome](cms::RenderedPage &&response) {
+    http::response<cms::FragmentBody> res{http::status::ok, req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
     res.set(http::field::content_type, CONTENT_TYPE_HTML);
     res.keep_alive(req.keep_alive());
-    res.body() = response;
+    res.body() = std::move(response);
     res.prepare_payload();
+    outcome.status = res.result_int();
     return res;
   };
 
@@ -187,81 +416,67 @@ handle_request(std::shared_ptr<cms::Post> post, std::shared_ptr<cms::Page> page,
     return bad_request("Illegal request-target");
   }
 
+  // Runtime metrics in Prometheus text format
+  if (req.method() == http::verb::get && req.target() == METRICS_PATH) {
+    outcome.route = request_route::metrics;
+    if (!serve_metrics) {
+      return not_found(req.target());
+    }
+    http::response<http::string_body> res{http::status::ok, req.version()};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
+    res.set(http::field::content_type, CONTENT_TYPE_METRICS);
+    res.keep_alive(req.keep_alive());
+    services::MetricsRegistry::instance().writePrometheus(res.body());
+    res.prepare_payload();
+    outcome.status = res.result_int();
+    return res;
+  }
+
   // Get the host from the Host header
   std::string_view host = req[http::field::host];
-  bsoncxx::stdx::string_view dbName = LOCALHOST_DB;
-  if (host.find("quizbin.com") != beast::string_view::npos) {
-    dbName = QUIZBIN_DB;
-  }
 
   // Build the path to the requested file
   std::string path = path_cat(doc_root, req.target());
 
   /** DEBUG
-  spdlog::debug("load page <{}> host <{}> db <{}>", req.target(), host, dbName);
+  spdlog::debug("load page <{}> host <{}>", req.target(), host);
   **/
 
-  std::string urlRequest{"http://"};
-  urlRequest.append(host);
-  urlRequest.append(req.target());
-  boost::system::result<boost::urls::url_view> urlResult =
-      boost::urls::parse_uri(urlRequest);
-
-  if (!urlResult.has_value()) {
+  auto route = route_content(host, req.target());
+  services::RequestTrace::markActive(services::RequestPhase::Routed);
+  if (route.type == content_route::kind::url_error) {
     return server_error("URL error encountered");
   }
-  if (urlResult.has_error()) {
-    return server_error("URL error encountered");
+  if (route.type == content_route::kind::page) {
+    outcome.route = request_route::page;
+  } else if (route.type == content_route::kind::post ||
+             route.type == content_route::kind::not_found) {
+    outcome.route = request_route::post;
   }
 
-  boost::urls::url_view urlView = urlResult.value();
-  auto segments = urlView.segments();
-
-  if (req.method() == http::verb::get && segments.size() == 0) {
-    // Handle the index route (/)
-    std::string content = page->getPage(host, dbName, "index");
-    return html_response(content);
-  } else if (req.method() == http::verb::get && segments.size() == 1 &&
-             req.target() == "/about") {
-    std::string content = page->getPage(host, dbName, "about");
-    return html_response(content);
-  } else if (req.method() == http::verb::get &&
-             req.target().find("/posts/") != beast::string_view::npos) {
-    int postId = NONE_POST_ID;
-    if (segments.size() >= 2) {
-      long unsigned int index = 0;
-      const long unsigned int lastSegment = segments.size() - 1;
-      for (const auto &segment : segments) {
-        if (index == lastSegment) {
-          // Converts string segment to int with numeric validation
-          auto [ptr, ec] = std::from_chars(
-              segment.data(), segment.data() + segment.size(), postId);
-          if (ec == std::errc() && ptr == segment.data() + segment.size()) {
-            break;
-          } else {
-            postId = NONE_POST_ID;
-          }
-          break;
-        } else if (index > MAX_POST_URL_SEGMENTS) {
-          break;
-        }
-        ++index;
-      }
-
-      if (postId == NONE_POST_ID) {
-        return not_found(req.target());
-      }
-
-      std::string content = post->getPost(host, dbName, postId);
-
-      if (postId > NONE_POST_ID && !content.empty()) {
-        return html_response(content);
+  try {
+    if (req.method() == http::verb::get &&
+        route.type == content_route::kind::page) {
+      auto content = page->getPage(host, route.dbName, route.pageId);
+      return html_response(std::move(content));
+    } else if (req.method() == http::verb::get &&
+               route.type == content_route::kind::not_found) {
+      return not_found(req.target());
+    } else if (req.method() == http::verb::get &&
+               route.type == content_route::kind::post) {
+      auto content = post->getPost(host, route.dbName, route.postId);
+      if (!content.empty()) {
+        return html_response(std::move(content));
       }
+      return not_found(req.target());
     }
-    return not_found(req.target());
+  } catch (const cms::ContentUnavailable &e) {
+    return service_unavailable(e.retryAfter());
   }
 
   // Attempt to open the file
+  outcome.route = request_route::static_file;
   beast::error_code ec;
   http::file_body::value_type body;
   body.open(path.c_str(), beast::file_mode::scan, ec);
@@ -279,13 +494,24 @@ handle_request(std::shared_ptr<cms::Post> post, std::shared_ptr<cms::Page> page,
   // Cache the size since we need it after the move
   auto const size = body.size();
 
+  // Modification time of the file, for Last-Modified
+  struct stat fileStat {};
+  bool const has_mtime = ::stat(path.c_str(), &fileStat) == 0;
+
   // Respond to HEAD request
   if (req.method() == http::verb::head) {
     http::response<http::empty_body> res{http::status::ok, req.version()};
     res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, http_date().view());
     res.set(http::field::content_type, mime_type(path));
+    if (has_mtime) {
+      res.set(http::field::last_modified,
+              services::formatHttpDate(fileStat.st_mtime).view());
+    }
+    set_static_freshness(res);
     res.content_length(size);
     res.keep_alive(req.keep_alive());
+    outcome.status = res.result_int();
     return res;
   }
 
@@ -294,9 +520,16 @@ handle_request(std::shared_ptr<cms::Post> post, std::shared_ptr<cms::Page> page,
       std::piecewise_construct, std::make_tuple(std::move(body)),
       std::make_tuple(http::status::ok, req.version())};
   res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+  res.set(http::field::date, http_date().view());
   res.set(http::field::content_type, mime_type(path));
+  if (has_mtime) {
+    res.set(http::field::last_modified,
+            services::formatHttpDate(fileStat.st_mtime).view());
+  }
+  set_static_freshness(res);
   res.content_length(size);
   res.keep_alive(req.keep_alive());
+  outcome.status = res.result_int();
   return res;
 }
 
@@ -320,19 +553,60 @@ class session : public boost::asio::coroutine,
   beast::tcp_stream stream_;
   beast::flat_buffer buffer_;
   std::shared_ptr<std::string const> doc_root_;
+  bool serve_metrics_;
   http::request<http::string_body> req_;
   bool keep_alive_ = true;
   std::shared_ptr<cms::Post> post;
   std::shared_ptr<cms::Page> page;
+  bool stream_pages_;
+
+  // A page sent in two chunks: the layout head before the fetch, then the
+  // rest once the document is rendered.
+  content_route route_;
+  std::optional<cms::RenderedPage> head_;
+  cms::RenderedPage tail_;
+  bool tail_failed_ = false;
+  std::optional<http::response<http::empty_body>> stream_res_;
+  std::optional<http::response_serializer<http::empty_body>> stream_sr_;
+
+  // The request being answered, for the request metrics and trace. The
+  // first request is timed from the accept, later ones from their read.
+  std::optional<http::message_generator> msg_;
+  request_outcome outcome_;
+  services::RequestTrace trace_;
+  std::chrono::steady_clock::time_point accepted_ =
+      std::chrono::steady_clock::now();
+  std::size_t request_bytes_ = 0;
+  std::size_t response_bytes_ = 0;
+  unsigned request_version_ = 11;
+  std::string remote_; // peer address, when the access log is on
+  uint64_t connection_id_ = 0; // for the traffic capture
+  std::string capture_;        // the current request, when capturing
 
 public:
   // Take ownership of the socket
   explicit session(tcp::socket &&socket,
                    std::shared_ptr<std::string const> const &doc_root,
                    std::shared_ptr<cms::Post> blogPost,
-                   std::shared_ptr<cms::Page> blogPage)
-      : stream_(std::move(socket)), doc_root_(doc_root), post(blogPost),
-        page(blogPage) {}
+                   std::shared_ptr<cms::Page> blogPage, bool streamPages,
+                   bool serveMetrics)
+      : stream_(std::move(socket)), doc_root_(doc_root),
+        serve_metrics_(serveMetrics), post(blogPost), page(blogPage),
+        stream_pages_(streamPages) {
+    http_metrics::instance().session_opened();
+    if (services::AccessLog::instance().enabled()) {
+      beast::error_code ec;
+      auto peer = stream_.socket().remote_endpoint(ec);
+      if (!ec) {
+        remote_ = peer.address().to_string();
+      }
+    }
+    if (services::TrafficCapture::instance().enabled()) {
+      connection_id_ = services::TrafficCapture::instance().nextConnection();
+    }
+  }
+
+  ~session() { http_metrics::instance().session_closed(); }
 
   // Start the asynchronous operation
   void run() {
@@ -349,11 +623,13 @@ public:
 
   void loop(beast::error_code ec, std::size_t bytes_transferred) {
     boost::ignore_unused(bytes_transferred);
+    services::IoWatchdog::Busy busy("session");
     reenter(*this) {
       for (;;) {
         // Make the request empty before reading,
         // otherwise the operation behavior is undefined.
         req_ = {};
+        trace_.start(accepted_);
 
         // Set the timeout.
         stream_.expires_after(std::chrono::seconds(30));
@@ -370,22 +646,106 @@ public:
         if (ec)
           return fail(ec, "read");
 
-        yield {
-          // Handle request
-          http::message_generator msg =
-              handle_request(post, page, *doc_root_, std::move(req_));
+        trace_.mark(services::RequestPhase::HeaderRead);
+        trace_.describe(method_name(req_.method()),
+                        std::string_view(req_.target().data(),
+                                         req_.target().size()));
+        outcome_ = {};
+        request_version_ = req_.version();
+        request_bytes_ = bytes_transferred;
+        response_bytes_ = 0;
+        if (services::TrafficCapture::instance().enabled()) {
+          capture_ = capture_request();
+        }
 
-          // Determine if we should close the connection
-          keep_alive_ = msg.keep_alive();
+        if (stream_pages_ && start_stream()) {
+          // Send the headers and layout head while the content is fetched
+          yield http::async_write_header(
+              stream_, *stream_sr_,
+              beast::bind_front_handler(&session::loop, shared_from_this()));
+          if (ec)
+            return fail(ec, "write");
+          response_bytes_ += bytes_transferred;
+          trace_.mark(services::RequestPhase::FirstByte);
 
-          // Send the response
-          beast::async_write(
-              stream_, std::move(msg),
+          yield net::async_write(
+              stream_, http::make_chunk(page_buffers(*head_)),
               beast::bind_front_handler(&session::loop, shared_from_this()));
-        }
+          if (ec)
+            return fail(ec, "write");
+          response_bytes_ += bytes_transferred;
+
+          finish_stream();
+          if (!tail_.empty()) {
+            yield net::async_write(
+                stream_, http::make_chunk(page_buffers(tail_)),
+                beast::bind_front_handler(&session::loop, shared_from_this()));
+            if (ec)
+              return fail(ec, "write");
+            response_bytes_ += bytes_transferred;
+          }
 
-        if (ec)
-          return fail(ec, "write");
+          // A failed fetch leaves the body unterminated, so the client sees
+          // a truncated response rather than a complete empty page.
+          if (!tail_failed_) {
+            yield net::async_write(
+                stream_, http::make_chunk_last(),
+                beast::bind_front_handler(&session::loop, shared_from_this()));
+            if (ec)
+              return fail(ec, "write");
+            response_bytes_ += bytes_transferred;
+          }
+          end_stream();
+        } else {
+          {
+            // Handle request
+            services::RequestTrace::Scope tracing(trace_);
+            msg_.emplace(handle_request(post, page, *doc_root_,
+                                        serve_metrics_, outcome_,
+                                        std::move(req_)));
+          }
+
+          // Determine if we should close the connection
+          keep_alive_ = msg_->keep_alive();
+
+          // Send the response a buffer sequence at a time, as
+          // beast::async_write would, so the first byte out is timed
+          while (!msg_->is_done()) {
+            yield {
+              beast::error_code prepare_ec;
+              auto buffers = msg_->prepare(prepare_ec);
+              if (prepare_ec) {
+                net::post(stream_.get_executor(),
+                          beast::bind_front_handler(&session::loop,
+                                                    shared_from_this(),
+                                                    prepare_ec, 0));
+              } else {
+                stream_.async_write_some(
+                    buffers, beast::bind_front_handler(&session::loop,
+                                                       shared_from_this()));
+              }
+            }
+            if (ec)
+              return fail(ec, "write");
+            msg_->consume(bytes_transferred);
+            response_bytes_ += bytes_transferred;
+            trace_.mark(services::RequestPhase::FirstByte);
+          }
+          msg_.reset();
+        }
+        trace_.mark(services::RequestPhase::LastByte);
+        http_metrics::instance().record(outcome_, request_bytes_,
+                                        response_bytes_, trace_.total());
+        services::RequestTracer::instance().finish(
+            trace_, request_route_names[static_cast<size_t>(outcome_.route)],
+            outcome_.status);
+        services::AccessLog::instance().record(
+            remote_, trace_.method(), trace_.target(), request_version_,
+            outcome_.status, response_bytes_, trace_.total());
+        services::TrafficCapture::instance().record(capture_, outcome_.status,
+                                                    response_bytes_);
+        capture_.clear();
+        accepted_ = std::chrono::steady_clock::now();
         if (!keep_alive_) {
           // This means we should close the connection, usually because
           // the response indicated the "Connection: close" semantic.
@@ -401,6 +761,115 @@ public:
   }
 
 #include <boost/asio/unyield.hpp>
+
+private:
+  static std::string_view method_name(http::verb method) {
+    auto name = http::to_string(method);
+    return {name.data(), name.size()};
+  }
+
+  // The request line and replay-relevant headers of req_, for the capture.
+  std::string capture_request() const {
+    std::array<services::CapturedHeader, services::kCapturedHeaders.size()>
+        headers;
+    std::size_t count = 0;
+    for (auto name : services::kCapturedHeaders) {
+      auto found = req_.find(beast::string_view(name.data(), name.size()));
+      if (found != req_.end()) {
+        headers[count++] = {name, std::string_view(found->value().data(),
+                                                   found->value().size())};
+      }
+    }
+    return services::TrafficCapture::instance().encodeRequest(
+        connection_id_, method_name(req_.method()),
+        std::string_view(req_.target().data(), req_.target().size()),
+        req_.version(), std::span(headers.data(), count));
+  }
+
+  static std::vector<net::const_buffer>
+  page_buffers(const cms::RenderedPage &rendered) {
+    std::vector<net::const_buffer> buffers;
+    buffers.reserve(rendered.pieces.size());
+    for (auto piece : rendered.pieces) {
+      buffers.emplace_back(piece.data(), piece.size());
+    }
+    return buffers;
+  }
+
+  // Stream GET requests for pages that are not cached but whose layout head
+  // is known; everything else goes through handle_request. HTTP/1.0 has no
+  // chunked encoding, so those requests are never streamed.
+  bool start_stream() {
+    if (req_.method() != http::verb::get || req_.version() < 11 ||
+        req_.target().empty() ||
+        req_.target()[0] != '/' ||
+        req_.target().find("..") != beast::string_view::npos) {
+      return false;
+    }
+    services::RequestTrace::Scope tracing(trace_);
+    route_ = route_content(req_[http::field::host], req_.target());
+    trace_.mark(services::RequestPhase::Routed);
+    if (route_.type == content_route::kind::page) {
+      head_ = page->getPageHead(route_.dbName, route_.pageId);
+    } else if (route_.type == content_route::kind::post) {
+      head_ = post->getPostHead(route_.dbName, route_.postId);
+    }
+    if (!head_ || head_->empty()) {
+      head_.reset();
+      return false;
+    }
+    outcome_.route = route_.type == content_route::kind::page
+                         ? request_route::page
+                         : request_route::post;
+    outcome_.status = static_cast<unsigned>(http::status::ok);
+
+    keep_alive_ = req_.keep_alive();
+    stream_res_.emplace(http::status::ok, req_.version());
+    stream_res_->set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    stream_res_->set(http::field::date, http_date().view());
+    stream_res_->set(http::field::content_type, CONTENT_TYPE_HTML);
+    stream_res_->keep_alive(keep_alive_);
+    stream_res_->chunked(true);
+    stream_sr_.emplace(*stream_res_);
+    return true;
+  }
+
+  // Fetch and render the rest of the page. The status has already gone out,
+  // so a document deleted since its stale copy, like an unavailable store,
+  // leaves the body unterminated and drops the connection.
+  void finish_stream() {
+    services::RequestTrace::Scope tracing(trace_);
+    std::string_view host = req_[http::field::host];
+    try {
+      if (route_.type == content_route::kind::page) {
+        tail_ = page->getPageTail(*head_, host, route_.dbName, route_.pageId);
+      } else {
+        tail_ = post->getPostTail(*head_, host, route_.dbName, route_.postId);
+      }
+    } catch (const cms::ContentUnavailable &e) {
+      spdlog::warn("streamed page {} unavailable: {}", req_.target(),
+                   e.what());
+      tail_ = {};
+      tail_failed_ = true;
+      keep_alive_ = false;
+      return;
+    }
+    if (tail_.empty()) {
+      spdlog::warn("streamed page {} no longer exists, response truncated",
+                   req_.target());
+      outcome_.status = static_cast<unsigned>(http::status::not_found);
+      tail_failed_ = true;
+      keep_alive_ = false;
+    }
+  }
+
+  void end_stream() {
+    stream_sr_.reset();
+    stream_res_.reset();
+    head_.reset();
+    tail_ = {};
+    tail_failed_ = false;
+  }
 };
 
 //------------------------------------------------------------------------------
@@ -414,15 +883,19 @@ class listener : public boost::asio::coroutine,
   std::shared_ptr<std::string const> doc_root_;
   std::shared_ptr<cms::Post> post;
   std::shared_ptr<cms::Page> page;
+  bool stream_pages_;
+  bool serve_metrics_;
 
 public:
   listener(net::io_context &ioc, tcp::endpoint endpoint,
            std::shared_ptr<std::string const> const &doc_root,
            std::shared_ptr<cms::Post> blogPost,
-           std::shared_ptr<cms::Page> blogPage)
+           std::shared_ptr<cms::Page> blogPage, bool streamPages = false,
+           bool serveMetrics = false)
       : ioc_(ioc), acceptor_(net::make_strand(ioc)),
         socket_(net::make_strand(ioc)), doc_root_(doc_root), post(blogPost),
-        page(blogPage) {
+        page(blogPage), stream_pages_(streamPages),
+        serve_metrics_(serveMetrics) {
     beast::error_code ec;
 
     // Open the acceptor
@@ -457,10 +930,17 @@ public:
   // Start accepting incoming connections
   void run() { loop(); }
 
+  // Address actually bound, e.g. the port chosen for port 0
+  tcp::endpoint local_endpoint() const {
+    beast::error_code ec;
+    return acceptor_.local_endpoint(ec);
+  }
+
 private:
 #include <boost/asio/yield.hpp>
 
   void loop(beast::error_code ec = {}) {
+    services::IoWatchdog::Busy busy("accept");
     reenter(*this) {
       for (;;) {
         yield acceptor_.async_accept(
@@ -470,7 +950,8 @@ private:
           fail(ec, "accept");
         } else {
           // Create the session and run it
-          std::make_shared<session>(std::move(socket_), doc_root_, post, page)
+          std::make_shared<session>(std::move(socket_), doc_root_, post, page,
+                                    stream_pages_, serve_metrics_)
               ->run();
         }
 
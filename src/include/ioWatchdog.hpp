@@ -0,0 +1,303 @@
+#pragma once
+
+#ifndef CMS_IO_WATCHDOG_HPP
+#define CMS_IO_WATCHDOG_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "metrics.hpp"
+#include "requestTrace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace services {
+
+struct IoThreadState;
+
+/**
+ * Watches the threads running the server's io_context. Handlers that mark
+ * themselves Busy are timed per thread, giving each thread's busy and idle
+ * time. A background thread posts a timestamped probe to the io_context at
+ * every interval and records how long it waited to run, which is the lag
+ * every queued handler sees. The same thread checks for an IO thread that
+ * has been inside one handler longer than the stall threshold, e.g. blocked
+ * on MongoDB or rendering a huge document. It logs the handler and the
+ * request phase the thread last reached, once per stall.
+ */
+class IoWatchdog {
+public:
+  struct Options {
+    std::chrono::milliseconds probeInterval{100};
+    std::chrono::milliseconds stallThreshold{250};
+  };
+
+  // Marks the calling thread busy for its lifetime, if the thread is
+  // attached; nested guards count as the outermost one.
+  class Busy {
+  public:
+    explicit Busy(const char *handler);
+    ~Busy();
+
+    Busy(const Busy &) = delete;
+    Busy &operator=(const Busy &) = delete;
+
+  private:
+    IoThreadState *state;
+    int64_t started = 0;
+  };
+
+  static IoWatchdog &instance();
+
+  ~IoWatchdog();
+
+  // Start probing ioc; call before it runs and stop() before it goes away.
+  void start(boost::asio::io_context &ioc, Options configured);
+  void stop();
+
+  // Register the calling thread as an IO thread; call before running the
+  // io_context on it.
+  void attach();
+
+  // Loop lag, handler times, per-thread busy and idle time, stalls.
+  void writeMetrics(std::string &out) const;
+
+  static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  IoWatchdog() = default;
+
+  static IoThreadState *&local();
+
+  void run();
+  void probe(int64_t now);
+  void checkStalls(int64_t now);
+
+  Options options;
+  boost::asio::io_context *ioc = nullptr;
+
+  mutable std::mutex threadsMutex;
+  std::vector<std::unique_ptr<IoThreadState>> threads;
+
+  std::atomic<int64_t> probePostedAt{0}; // 0 when no probe is queued
+  int64_t reportedProbe = 0;             // watcher thread only
+  LatencyHistogram loopLag;
+  Counter stalls;
+
+  std::thread watcher;
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+};
+
+// One IO thread, written by that thread and read by the watcher and scrapes.
+struct alignas(detail::kCacheLineSize) IoThreadState {
+  unsigned index = 0;
+  long tid = 0;
+  int64_t attachedAt = 0;
+  std::atomic<int64_t> busySince{0}; // 0 when idle
+  std::atomic<const char *> handler{nullptr};
+  std::atomic<uint8_t> phase{static_cast<uint8_t>(RequestPhase::Accepted)};
+  std::atomic<uint64_t> busyNanos{0};
+  std::atomic<uint64_t> handlers{0};
+  LatencyHistogram handlerTime;
+  int depth = 0;             // owning thread only
+  int64_t reportedStall = 0; // watcher thread only
+};
+
+IoWatchdog &IoWatchdog::instance() {
+  static IoWatchdog watchdog;
+  return watchdog;
+}
+
+IoWatchdog::~IoWatchdog() { stop(); }
+
+IoThreadState *&IoWatchdog::local() {
+  thread_local IoThreadState *state = nullptr;
+  return state;
+}
+
+IoWatchdog::Busy::Busy(const char *handler) : state(local()) {
+  if (!state || state->depth++ > 0) {
+    return;
+  }
+  started = nowNanos();
+  state->handler.store(handler, std::memory_order_relaxed);
+  state->busySince.store(started, std::memory_order_release);
+}
+
+IoWatchdog::Busy::~Busy() {
+  if (!state || --state->depth > 0) {
+    return;
+  }
+  int64_t elapsed = nowNanos() - started;
+  state->busySince.store(0, std::memory_order_relaxed);
+  // Only this thread writes its totals, so no read-modify-write is needed.
+  state->busyNanos.store(
+      state->busyNanos.load(std::memory_order_relaxed) + elapsed,
+      std::memory_order_relaxed);
+  state->handlers.store(state->handlers.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+  state->handlerTime.record(static_cast<uint64_t>(elapsed / 1000));
+}
+
+void IoWatchdog::start(boost::asio::io_context &context,
+                       Options configured) {
+  options = configured;
+  ioc = &context;
+  stopping = false;
+  watcher = std::thread([this] { run(); });
+}
+
+void IoWatchdog::stop() {
+  if (!watcher.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  watcher.join();
+}
+
+void IoWatchdog::attach() {
+  if (local()) {
+    return;
+  }
+  auto state = std::make_unique<IoThreadState>();
+  state->tid = ::syscall(SYS_gettid);
+  state->attachedAt = nowNanos();
+  std::atomic<uint8_t> *beacon = &state->phase;
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  state->index = static_cast<unsigned>(threads.size());
+  local() = state.get();
+  RequestTrace::phaseBeacon() = beacon;
+  threads.push_back(std::move(state));
+}
+
+void IoWatchdog::run() {
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (!wake.wait_for(lock, options.probeInterval,
+                        [this] { return stopping; })) {
+    lock.unlock();
+    int64_t now = nowNanos();
+    probe(now);
+    checkStalls(now);
+    lock.lock();
+  }
+}
+
+void IoWatchdog::probe(int64_t now) {
+  int64_t posted = probePostedAt.load(std::memory_order_acquire);
+  if (posted == 0) {
+    probePostedAt.store(now, std::memory_order_release);
+    boost::asio::post(*ioc, [this, now] {
+      loopLag.record(static_cast<uint64_t>((nowNanos() - now) / 1000));
+      probePostedAt.store(0, std::memory_order_release);
+    });
+    return;
+  }
+  // Still queued: every handler posted since has been waiting this long.
+  auto waited = std::chrono::nanoseconds(now - posted);
+  if (waited >= options.stallThreshold && reportedProbe != posted) {
+    reportedProbe = posted;
+    spdlog::warn("io loop lagging probe_wait_ms={:.1f}",
+                 waited.count() / 1e6);
+  }
+}
+
+void IoWatchdog::checkStalls(int64_t now) {
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (auto &state : threads) {
+    int64_t since = state->busySince.load(std::memory_order_acquire);
+    if (since == 0 || since == state->reportedStall ||
+        std::chrono::nanoseconds(now - since) < options.stallThreshold) {
+      continue;
+    }
+    state->reportedStall = since;
+    stalls.add();
+    const char *handler = state->handler.load(std::memory_order_relaxed);
+    auto phase = state->phase.load(std::memory_order_relaxed);
+    spdlog::warn("io thread stalled thread={} tid={} handler={} "
+                 "last_phase={} busy_ms={:.1f}",
+                 state->index, state->tid, handler ? handler : "unknown",
+                 kRequestPhaseNames[phase < kRequestPhaseCount ? phase : 0],
+                 (now - since) / 1e6);
+  }
+}
+
+void IoWatchdog::writeMetrics(std::string &out) const {
+  writeMetricHeader(out, "cms_io_loop_lag_seconds", "histogram",
+                    "Time a probe posted to the io_context waited to run.");
+  writeHistogram(out, "cms_io_loop_lag_seconds", "", loopLag.snapshot());
+  writeMetricHeader(out, "cms_io_stalls_total", "counter",
+                    "Handlers that ran longer than the stall threshold.");
+  writeSample(out, "cms_io_stalls_total", "", stalls.value());
+
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  LatencyHistogram::Snapshot handlerTime;
+  for (const auto &state : threads) {
+    handlerTime.merge(state->handlerTime.snapshot());
+  }
+  writeMetricHeader(out, "cms_io_handler_duration_seconds", "histogram",
+                    "Time IO threads spent in one handler.");
+  writeHistogram(out, "cms_io_handler_duration_seconds", "", handlerTime);
+
+  int64_t now = nowNanos();
+  auto out_it = std::back_inserter(out);
+  writeMetricHeader(out, "cms_io_thread_busy_seconds_total", "counter",
+                    "Time each IO thread spent running handlers.");
+  for (const auto &state : threads) {
+    fmt::format_to(out_it, "cms_io_thread_busy_seconds_total{{thread=\"{}\"}} "
+                           "{}\n",
+                   state->index,
+                   state->busyNanos.load(std::memory_order_relaxed) / 1e9);
+  }
+  writeMetricHeader(out, "cms_io_thread_idle_seconds_total", "counter",
+                    "Time each IO thread spent waiting for work.");
+  for (const auto &state : threads) {
+    auto busy = state->busyNanos.load(std::memory_order_relaxed);
+    fmt::format_to(out_it, "cms_io_thread_idle_seconds_total{{thread=\"{}\"}} "
+                           "{}\n",
+                   state->index,
+                   std::max<int64_t>(0, now - state->attachedAt -
+                                            static_cast<int64_t>(busy)) /
+                       1e9);
+  }
+  writeMetricHeader(out, "cms_io_thread_handlers_total", "counter",
+                    "Handlers each IO thread has run.");
+  for (const auto &state : threads) {
+    writeSample(out, "cms_io_thread_handlers_total",
+                fmt::format("thread=\"{}\"", state->index),
+                state->handlers.load(std::memory_order_relaxed));
+  }
+}
+
+} // namespace services
+
+#endif // CMS_IO_WATCHDOG_HPP
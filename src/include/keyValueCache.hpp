@@ -3,16 +3,16 @@
 #ifndef CMS_KEYVALUECACHE_HPP
 #define CMS_KEYVALUECACHE_HPP
 
-#include <chrono>
-#include <mutex>
-#include <optional>
-#include <string>
-#include <vector>
+#include "metrics.hpp"
 
 #include <chrono>
+#include <cstdint>
+#include <initializer_list>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace services {
@@ -22,20 +22,32 @@ using TimePoint = Clock::time_point;
 using Duration = Clock::duration;
 using string = std::string;
 
-class KeyValueCache {
+// Counters of a cache since it was created, plus its current contents.
+struct CacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0; // entries dropped to make room or on expiry
+  size_t entries = 0;
+  size_t bytes = 0; // keys plus values that report a size()
+};
+
+// Fixed-capacity TTL cache; Value is copied out on get, so large values
+// should be cheap to copy (e.g. hold their bytes through shared_ptr).
+// Statistics are kept under the lock every operation already takes.
+template <typename Value> class BasicKeyValueCache {
 public:
   struct KeyValue {
     string key;
-    string value;
+    Value value;
     TimePoint expiry;
     bool isExpired() const { return Clock::now() >= expiry; }
   };
 
-  explicit KeyValueCache(size_t capacity)
+  explicit BasicKeyValueCache(size_t capacity)
       : buffer(capacity), capacity(capacity) {}
 
   // Set a key-value pair with TTL (seconds); returns false if buffer is full.
-  bool set(const string &key, const string &value, int64_t ttlSeconds) {
+  bool set(const string &key, const Value &value, int64_t ttlSeconds) {
     std::lock_guard<std::mutex> lock(mutex);
     if (sizeCount == capacity) {
       // Try to evict expired items.
@@ -49,7 +61,9 @@ public:
     for (size_t i = 0; i < sizeCount; ++i) {
       size_t index = (head + i) % capacity;
       if (buffer[index].key == key && !buffer[index].isExpired()) {
+        bytes -= entryBytes(buffer[index]);
         buffer[index].value = value;
+        bytes += entryBytes(buffer[index]);
         buffer[index].expiry =
             Clock::now() + Duration(std::chrono::seconds(ttlSeconds));
         return true;
@@ -60,12 +74,38 @@ public:
     size_t index = (head + sizeCount) % capacity;
     buffer[index] = KeyValue{
         key, value, Clock::now() + Duration(std::chrono::seconds(ttlSeconds))};
+    bytes += entryBytes(buffer[index]);
     ++sizeCount;
     return true;
   }
 
+  // Set a key-value pair with TTL (seconds), evicting the oldest entry when
+  // the buffer is full instead of failing.
+  void put(const string &key, const Value &value, int64_t ttlSeconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < sizeCount; ++i) {
+      size_t index = (head + i) % capacity;
+      if (buffer[index].key == key) {
+        removeAtIndex(i);
+        break;
+      }
+    }
+    if (sizeCount == capacity) {
+      evictExpired();
+      if (sizeCount == capacity) {
+        removeAtIndex(0);
+        ++evictions;
+      }
+    }
+    size_t index = (head + sizeCount) % capacity;
+    buffer[index] = KeyValue{
+        key, value, Clock::now() + Duration(std::chrono::seconds(ttlSeconds))};
+    bytes += entryBytes(buffer[index]);
+    ++sizeCount;
+  }
+
   // Get a value by key; returns empty optional if not found or expired.
-  std::optional<string> get(const string &key) {
+  std::optional<Value> get(const string &key) {
     std::lock_guard<std::mutex> lock(mutex);
     for (size_t i = 0; i < sizeCount; ++i) {
       size_t index = (head + i) % capacity;
@@ -73,6 +113,26 @@ public:
         if (buffer[index].isExpired()) {
           // Remove expired item.
           removeAtIndex(i);
+          ++evictions;
+          ++misses;
+          return std::nullopt;
+        }
+        ++hits;
+        return buffer[index].value;
+      }
+    }
+    ++misses;
+    return std::nullopt;
+  }
+
+  // Like get, but neither counted in the statistics nor evicting: for
+  // probes that are followed by the real lookup.
+  std::optional<Value> peek(const string &key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < sizeCount; ++i) {
+      size_t index = (head + i) % capacity;
+      if (buffer[index].key == key) {
+        if (buffer[index].isExpired()) {
           return std::nullopt;
         }
         return buffer[index].value;
@@ -103,12 +163,18 @@ public:
 
   bool empty() const { return sizeCount == 0; }
 
+  CacheStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return CacheStats{hits, misses, evictions, sizeCount, bytes};
+  }
+
 private:
   void evictExpired() {
     for (size_t i = 0; i < sizeCount; ++i) {
       size_t index = (head + i) % capacity;
       if (buffer[index].isExpired()) {
         removeAtIndex(i);
+        ++evictions;
         --i; // Re-check the same index after removal.
       }
     }
@@ -119,6 +185,7 @@ private:
       return;
 
     size_t index = (head + pos) % capacity;
+    bytes -= entryBytes(buffer[index]);
     if (pos == 0) {
       // Remove from head.
       buffer[index] = KeyValue{};
@@ -136,13 +203,63 @@ private:
     }
   }
 
+  static size_t entryBytes(const KeyValue &entry) {
+    if constexpr (requires { entry.value.size(); }) {
+      return entry.key.size() + entry.value.size();
+    } else {
+      return entry.key.size();
+    }
+  }
+
   std::vector<KeyValue> buffer;
   size_t capacity;
   size_t head = 0;
   size_t sizeCount = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t bytes = 0;
   mutable std::mutex mutex;
 };
 
+using KeyValueCache = BasicKeyValueCache<string>;
+
+// Prometheus metrics for several caches, labelled cache="<name>".
+void writeCacheMetrics(
+    string &out, std::string_view prefix,
+    std::initializer_list<std::pair<std::string_view, CacheStats>> caches) {
+  struct Metric {
+    std::string_view suffix, type, help;
+    uint64_t CacheStats::*counter;
+    size_t CacheStats::*gauge;
+  };
+  static constexpr Metric kMetrics[] = {
+      {"_hits_total", "counter", "Cache lookups that found a live entry.",
+       &CacheStats::hits, nullptr},
+      {"_misses_total", "counter", "Cache lookups that found nothing.",
+       &CacheStats::misses, nullptr},
+      {"_evictions_total", "counter",
+       "Entries dropped for room or on expiry.", &CacheStats::evictions,
+       nullptr},
+      {"_entries", "gauge", "Entries held.", nullptr, &CacheStats::entries},
+      {"_bytes", "gauge", "Bytes held by keys and values.", nullptr,
+       &CacheStats::bytes},
+  };
+  for (const auto &metric : kMetrics) {
+    string name(prefix);
+    name.append(metric.suffix);
+    writeMetricHeader(out, name, metric.type, metric.help);
+    for (const auto &[cacheName, stats] : caches) {
+      string labels = "cache=\"";
+      labels.append(cacheName);
+      labels.append("\"");
+      writeSample(out, name, labels,
+                  metric.counter ? stats.*metric.counter
+                                 : stats.*metric.gauge);
+    }
+  }
+}
+
 } // namespace services
 
 #endif // CMS_KEYVALUECACHE_HPP
\ No newline at end of file
@@ -0,0 +1,380 @@
+#pragma once
+
+#ifndef CMS_LAYOUT_TEMPLATE_HPP
+#define CMS_LAYOUT_TEMPLATE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cms {
+
+/**
+ * Named placeholders a layout may contain. The body has no placeholder: it
+ * always goes between the layout header and footer.
+ */
+enum class LayoutSlot : uint8_t { Title, Description, Canonical, Date, Body };
+
+constexpr size_t kLayoutSlotCount = 5;
+
+constexpr std::array<std::pair<std::string_view, LayoutSlot>, 4>
+    kLayoutPlaceholders{{
+        {"%REPLACE_WITH_TITLE_ID%", LayoutSlot::Title},
+        {"%REPLACE_WITH_DESCRIPTION%", LayoutSlot::Description},
+        {"%REPLACE_WITH_CANONICAL_PATH%", LayoutSlot::Canonical},
+        {"%REPLACE_WITH_DATE%", LayoutSlot::Date},
+    }};
+
+// Values for each slot of a page, indexed by LayoutSlot.
+struct LayoutSlotValues {
+  std::array<std::string_view, kLayoutSlotCount> values{};
+
+  std::string_view &operator[](LayoutSlot slot) {
+    return values[static_cast<size_t>(slot)];
+  }
+  std::string_view operator[](LayoutSlot slot) const {
+    return values[static_cast<size_t>(slot)];
+  }
+};
+
+// The bytes unique to one page: its slot values, packed into one buffer.
+class PageSlots {
+public:
+  PageSlots() = default;
+  explicit PageSlots(const LayoutSlotValues &values);
+
+  std::string_view operator[](LayoutSlot slot) const;
+
+  size_t size() const { return bytes ? bytes->size() : 0; }
+
+private:
+  std::shared_ptr<const std::string> bytes;
+  std::array<std::pair<uint32_t, uint32_t>, kLayoutSlotCount> ranges{};
+};
+
+class LayoutTemplate;
+
+// Part of a page to assemble: all of it, or either side of the body start.
+enum class PagePart { Whole, Head, Tail };
+
+/**
+ * A page as views into refcounted storage: the shared literals of its
+ * compiled layout and the page's own slot bytes. Copies share both, and the
+ * pieces can be written with one gathered write.
+ */
+struct RenderedPage {
+  std::shared_ptr<const LayoutTemplate> layout;
+  PageSlots slots;
+  std::vector<std::string_view> pieces;
+  size_t size = 0;
+
+  bool empty() const { return size == 0; }
+
+  // The page as one contiguous string.
+  std::string str() const;
+};
+
+/**
+ * A layout compiled once into literal chunks and slots, so filling a page
+ * writes each segment straight into an exactly sized output instead of
+ * searching and copying the assembled page.
+ */
+class LayoutTemplate {
+public:
+  LayoutTemplate(std::string_view header, std::string_view footer,
+                 int64_t layoutVersion);
+
+  int64_t version() const { return version_; }
+
+  // Output size for the given slot values.
+  size_t size(const LayoutSlotValues &slots) const;
+
+  std::string render(const LayoutSlotValues &slots) const;
+
+  // Append the page to out, which is grown once to the exact size.
+  void renderTo(const LayoutSlotValues &slots, std::string &out) const;
+
+  // Lay the page's slots out in the layout without copying either; a null
+  // layout yields the body alone. Head is everything before the body and
+  // Tail the body onwards, for sending a page in two parts.
+  static RenderedPage assemble(std::shared_ptr<const LayoutTemplate> layout,
+                               const PageSlots &slots,
+                               PagePart part = PagePart::Whole);
+
+private:
+  struct Segment {
+    uint32_t offset; // into source_, for literals
+    uint32_t length;
+    bool isSlot;
+    LayoutSlot slot;
+  };
+
+  void compile(size_t begin, size_t end);
+
+  std::string source_;
+  std::vector<Segment> segments_;
+  size_t literalSize_ = 0;
+  std::array<uint32_t, kLayoutSlotCount> slotCounts_{};
+  int64_t version_;
+};
+
+/**
+ * Compiled layouts keyed by database and layout id; an entry is recompiled
+ * when the layout version changes, so at most one version is kept per id.
+ * Each entry also remembers when it was last confirmed against the store,
+ * so layouts of cached pages can be revalidated on their own schedule.
+ */
+class LayoutTemplateCache {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  std::shared_ptr<const LayoutTemplate> get(std::string_view dbName,
+                                            int layoutId, int64_t version,
+                                            std::string_view header,
+                                            std::string_view footer);
+
+  // Most recently compiled version of a layout, if any.
+  std::shared_ptr<const LayoutTemplate> current(std::string_view dbName,
+                                                int layoutId) const;
+
+  // True, for exactly one caller, when the layout was last confirmed more
+  // than interval ago; that caller is expected to refetch it.
+  bool claimRecheck(std::string_view dbName, int layoutId,
+                    Clock::duration interval);
+
+private:
+  using Key = std::pair<std::string, int>;
+
+  mutable std::shared_mutex mutex;
+  std::map<Key, std::shared_ptr<const LayoutTemplate>, std::less<>> templates;
+  std::map<Key, Clock::time_point, std::less<>> checkedAt;
+};
+
+/**
+ * Version of a layout: FNV-1a of its header and footer, so every edit yields
+ * a new version whether or not the layout's updatedAt was bumped.
+ */
+int64_t layoutContentVersion(std::string_view header,
+                             std::string_view footer) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (auto part : {header, footer}) {
+    for (unsigned char byte : part) {
+      hash ^= byte;
+      hash *= 1099511628211ULL;
+    }
+    hash ^= 0xff; // separator, so moving bytes across parts changes the hash
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<int64_t>(hash);
+}
+
+PageSlots::PageSlots(const LayoutSlotValues &values) {
+  size_t total = 0;
+  for (auto value : values.values) {
+    total += value.size();
+  }
+  auto packed = std::make_shared<std::string>();
+  packed->reserve(total);
+  for (size_t i = 0; i < kLayoutSlotCount; ++i) {
+    ranges[i] = {static_cast<uint32_t>(packed->size()),
+                 static_cast<uint32_t>(values.values[i].size())};
+    packed->append(values.values[i]);
+  }
+  bytes = std::move(packed);
+}
+
+std::string_view PageSlots::operator[](LayoutSlot slot) const {
+  if (!bytes) {
+    return {};
+  }
+  auto [offset, length] = ranges[static_cast<size_t>(slot)];
+  return std::string_view(*bytes).substr(offset, length);
+}
+
+std::string RenderedPage::str() const {
+  std::string out;
+  out.reserve(size);
+  for (auto piece : pieces) {
+    out.append(piece);
+  }
+  return out;
+}
+
+LayoutTemplate::LayoutTemplate(std::string_view header,
+                               std::string_view footer, int64_t layoutVersion)
+    : version_(layoutVersion) {
+  source_.reserve(header.size() + footer.size());
+  source_.append(header);
+  source_.append(footer);
+  compile(0, header.size());
+  segments_.push_back(Segment{0, 0, true, LayoutSlot::Body});
+  ++slotCounts_[static_cast<size_t>(LayoutSlot::Body)];
+  compile(header.size(), source_.size());
+}
+
+void LayoutTemplate::compile(size_t begin, size_t end) {
+  std::string_view text(source_);
+  size_t literalStart = begin;
+  size_t position = begin;
+  while (position < end) {
+    position = text.find('%', position);
+    if (position == std::string_view::npos || position >= end) {
+      break;
+    }
+    bool matched = false;
+    for (const auto &[placeholder, slot] : kLayoutPlaceholders) {
+      if (position + placeholder.size() <= end &&
+          text.compare(position, placeholder.size(), placeholder) == 0) {
+        if (position > literalStart) {
+          segments_.push_back(
+              Segment{static_cast<uint32_t>(literalStart),
+                      static_cast<uint32_t>(position - literalStart), false,
+                      LayoutSlot::Body});
+          literalSize_ += position - literalStart;
+        }
+        segments_.push_back(Segment{0, 0, true, slot});
+        ++slotCounts_[static_cast<size_t>(slot)];
+        position += placeholder.size();
+        literalStart = position;
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) {
+      ++position;
+    }
+  }
+  if (end > literalStart) {
+    segments_.push_back(Segment{static_cast<uint32_t>(literalStart),
+                                static_cast<uint32_t>(end - literalStart),
+                                false, LayoutSlot::Body});
+    literalSize_ += end - literalStart;
+  }
+}
+
+size_t LayoutTemplate::size(const LayoutSlotValues &slots) const {
+  size_t total = literalSize_;
+  for (size_t i = 0; i < kLayoutSlotCount; ++i) {
+    total += slotCounts_[i] * slots.values[i].size();
+  }
+  return total;
+}
+
+std::string LayoutTemplate::render(const LayoutSlotValues &slots) const {
+  std::string out;
+  renderTo(slots, out);
+  return out;
+}
+
+void LayoutTemplate::renderTo(const LayoutSlotValues &slots,
+                              std::string &out) const {
+  out.reserve(out.size() + size(slots));
+  for (const auto &segment : segments_) {
+    if (segment.isSlot) {
+      out.append(slots[segment.slot]);
+    } else {
+      out.append(source_, segment.offset, segment.length);
+    }
+  }
+}
+
+RenderedPage
+LayoutTemplate::assemble(std::shared_ptr<const LayoutTemplate> layout,
+                         const PageSlots &slots, PagePart part) {
+  RenderedPage page;
+  page.slots = slots;
+  auto addPiece = [&page](std::string_view piece) {
+    if (!piece.empty()) {
+      page.pieces.push_back(piece);
+      page.size += piece.size();
+    }
+  };
+  if (!layout) {
+    if (part != PagePart::Head) {
+      addPiece(slots[LayoutSlot::Body]);
+    }
+    return page;
+  }
+  std::string_view source(layout->source_);
+  page.pieces.reserve(layout->segments_.size());
+  bool inTail = false;
+  for (const auto &segment : layout->segments_) {
+    inTail = inTail || (segment.isSlot && segment.slot == LayoutSlot::Body);
+    if ((part == PagePart::Head && inTail) ||
+        (part == PagePart::Tail && !inTail)) {
+      continue;
+    }
+    addPiece(segment.isSlot ? slots[segment.slot]
+                            : source.substr(segment.offset, segment.length));
+  }
+  page.layout = std::move(layout);
+  return page;
+}
+
+std::shared_ptr<const LayoutTemplate>
+LayoutTemplateCache::current(std::string_view dbName, int layoutId) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto found = templates.find(Key{std::string(dbName), layoutId});
+  return found != templates.end() ? found->second : nullptr;
+}
+
+std::shared_ptr<const LayoutTemplate>
+LayoutTemplateCache::get(std::string_view dbName, int layoutId,
+                         int64_t version, std::string_view header,
+                         std::string_view footer) {
+  Key key{std::string(dbName), layoutId};
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = templates.find(key);
+    if (found != templates.end() && found->second->version() == version) {
+      return found->second;
+    }
+  }
+  // Compile outside the lock; a concurrent compile of the same layout just
+  // replaces an identical template.
+  auto compiled =
+      std::make_shared<const LayoutTemplate>(header, footer, version);
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  checkedAt.insert_or_assign(key, Clock::now());
+  templates.insert_or_assign(std::move(key), compiled);
+  return compiled;
+}
+
+bool LayoutTemplateCache::claimRecheck(std::string_view dbName, int layoutId,
+                                       Clock::duration interval) {
+  Key key{std::string(dbName), layoutId};
+  auto now = Clock::now();
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = checkedAt.find(key);
+    if (found != checkedAt.end() && now - found->second < interval) {
+      return false;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto [entry, inserted] = checkedAt.try_emplace(std::move(key), now);
+  if (!inserted) {
+    if (now - entry->second < interval) {
+      return false; // another thread claimed it meanwhile
+    }
+    entry->second = now;
+  }
+  return true;
+}
+
+} // namespace cms
+
+#endif // CMS_LAYOUT_TEMPLATE_HPP
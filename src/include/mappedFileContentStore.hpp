@@ -0,0 +1,240 @@
+#pragma once
+
+#ifndef CMS_MAPPED_FILE_CONTENT_STORE_HPP
+#define CMS_MAPPED_FILE_CONTENT_STORE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "contentStore.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bsoncxx/document/view.hpp>
+#include <spdlog/spdlog.h>
+
+namespace cms {
+
+/**
+ * Read-only ContentStore serving straight out of memory-mapped `mongodump`
+ * output, i.e. <root>/<db>/<collection>.bson files of concatenated BSON
+ * documents. The id index is built once at open; lookups return views into
+ * the mapping and never copy document data.
+ */
+class MappedFileContentStore : public ContentStore {
+public:
+  explicit MappedFileContentStore(const string &dumpDirectory);
+  ~MappedFileContentStore() override;
+
+  MappedFileContentStore(const MappedFileContentStore &) = delete;
+  MappedFileContentStore &operator=(const MappedFileContentStore &) = delete;
+
+  std::optional<ContentDocument>
+  getDocument(std::string_view dbName, std::string_view collectionName,
+              const ContentIdType &idType, std::string_view idValue) override;
+
+  std::optional<ContentLayout> getLayout(std::string_view dbName,
+                                         int layoutId) override;
+
+  std::optional<string> getMode(std::string_view dbName, int modeId) override;
+
+  std::vector<string> listIds(std::string_view dbName,
+                              std::string_view collectionName) override;
+
+private:
+  struct Mapping {
+    void *data;
+    size_t size;
+  };
+
+  using Collection = std::map<string, bsoncxx::document::view, std::less<>>;
+  using Database = std::map<string, Collection, std::less<>>;
+
+  void mapCollection(const std::filesystem::path &filePath, Collection &into);
+
+  const bsoncxx::document::view *find(std::string_view dbName,
+                                      std::string_view collectionName,
+                                      std::string_view idValue) const;
+
+  std::vector<Mapping> mappings;
+  // Immutable after construction, so lookups need no locking.
+  std::map<string, Database, std::less<>> databases;
+};
+
+MappedFileContentStore::MappedFileContentStore(const string &dumpDirectory) {
+  namespace fs = std::filesystem;
+  const std::array<std::string_view, 4> kCollections{"modes", "layouts",
+                                                     "pages", "posts"};
+
+  if (!fs::is_directory(dumpDirectory)) {
+    throw std::invalid_argument("Invalid content dump directory: " +
+                                dumpDirectory);
+  }
+  try {
+    for (const auto &entry : fs::directory_iterator(dumpDirectory)) {
+      if (!entry.is_directory()) {
+        continue;
+      }
+      auto &database = databases[entry.path().filename().string()];
+      for (auto collectionName : kCollections) {
+        auto filePath = entry.path() / (string(collectionName) + ".bson");
+        if (fs::exists(filePath)) {
+          mapCollection(filePath, database[string(collectionName)]);
+        }
+      }
+    }
+  } catch (...) {
+    for (const auto &mapping : mappings) {
+      munmap(mapping.data, mapping.size);
+    }
+    throw;
+  }
+}
+
+MappedFileContentStore::~MappedFileContentStore() {
+  for (const auto &mapping : mappings) {
+    munmap(mapping.data, mapping.size);
+  }
+}
+
+void MappedFileContentStore::mapCollection(
+    const std::filesystem::path &filePath, Collection &into) {
+  int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw std::runtime_error("Unable to open " + filePath.string() + ": " +
+                             std::strerror(errno));
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) == -1) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error("Unable to stat " + filePath.string() + ": " +
+                             std::strerror(error));
+  }
+  size_t size = static_cast<size_t>(fileStat.st_size);
+  if (size == 0) {
+    close(fd);
+    return;
+  }
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + filePath.string() + ": " +
+                             std::strerror(errno));
+  }
+  mappings.push_back(Mapping{data, size});
+  madvise(data, size, MADV_WILLNEED);
+
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  size_t offset = 0;
+  while (offset + 5 <= size) {
+    uint32_t length = 0;
+    std::memcpy(&length, bytes + offset, sizeof(length)); // little-endian
+    if (length < 5 || length > size - offset) {
+      spdlog::error("Truncated BSON document in {} at offset {}",
+                    filePath.string(), offset);
+      break;
+    }
+    bsoncxx::document::view document(bytes + offset, length);
+    into.insert_or_assign(bsonIdString(document), document);
+    offset += length;
+  }
+}
+
+const bsoncxx::document::view *
+MappedFileContentStore::find(std::string_view dbName,
+                             std::string_view collectionName,
+                             std::string_view idValue) const {
+  auto database = databases.find(dbName);
+  if (database == databases.end()) {
+    return nullptr;
+  }
+  auto collection = database->second.find(collectionName);
+  if (collection == database->second.end()) {
+    return nullptr;
+  }
+  auto document = collection->second.find(idValue);
+  if (document == collection->second.end()) {
+    return nullptr;
+  }
+  return &document->second;
+}
+
+std::optional<ContentDocument>
+MappedFileContentStore::getDocument(std::string_view dbName,
+                                    std::string_view collectionName,
+                                    const ContentIdType &idType,
+                                    std::string_view idValue) {
+  // Both id types are keyed by their string form.
+  (void)idType;
+
+  const auto *document = find(dbName, collectionName, idValue);
+  if (document == nullptr) {
+    return std::nullopt;
+  }
+  // Same join semantics as the MongoDB $lookup/$unwind pipeline.
+  auto modeId = bsonInt64(*document, kDocumentModeIdField);
+  auto layoutId = bsonInt64(*document, kDocumentLayoutIdField);
+  const auto *layout = find(dbName, "layouts", std::to_string(layoutId));
+  if (layout == nullptr ||
+      find(dbName, "modes", std::to_string(modeId)) == nullptr) {
+    return std::nullopt;
+  }
+  return makeContentDocument(*document, *layout, nullptr);
+}
+
+std::optional<ContentLayout>
+MappedFileContentStore::getLayout(std::string_view dbName, int layoutId) {
+  const auto *layout = find(dbName, "layouts", std::to_string(layoutId));
+  if (layout == nullptr) {
+    return std::nullopt;
+  }
+  return makeContentLayout(*layout, nullptr);
+}
+
+std::optional<string> MappedFileContentStore::getMode(std::string_view dbName,
+                                                      int modeId) {
+  const auto *mode = find(dbName, "modes", std::to_string(modeId));
+  if (mode == nullptr) {
+    return std::nullopt;
+  }
+  return string(bsonString(*mode, kModeNameField));
+}
+
+std::vector<string>
+MappedFileContentStore::listIds(std::string_view dbName,
+                                std::string_view collectionName) {
+  std::vector<string> ids;
+  auto database = databases.find(dbName);
+  if (database == databases.end()) {
+    return ids;
+  }
+  auto collection = database->second.find(collectionName);
+  if (collection == database->second.end()) {
+    return ids;
+  }
+  ids.reserve(collection->second.size());
+  for (const auto &[id, document] : collection->second) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+} // namespace cms
+
+#endif // CMS_MAPPED_FILE_CONTENT_STORE_HPP
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef CMS_MARKDOWN_HPP
+#define CMS_MARKDOWN_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "allocator.hpp"
+#include "renderArena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <cmark.h>
+
+namespace cms {
+
+// Options every markdown document is rendered with.
+constexpr int kMarkdownOptions = CMARK_OPT_DEFAULT;
+
+/**
+ * Fingerprint of everything that determines the rendered HTML of a markdown
+ * source: the cmark version, the render options and the source itself
+ * (64-bit FNV-1a). Stored HTML is only used while this still matches.
+ */
+uint64_t markdownHash(std::string_view source) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](std::string_view bytes) {
+    for (unsigned char byte : bytes) {
+      hash ^= byte;
+      hash *= 1099511628211ULL;
+    }
+  };
+  const int version = cmark_version();
+  const int options = kMarkdownOptions;
+  mix(std::string_view(reinterpret_cast<const char *>(&version),
+                       sizeof(version)));
+  mix(std::string_view(reinterpret_cast<const char *>(&options),
+                       sizeof(options)));
+  mix(source);
+  return hash;
+}
+
+/**
+ * Render source and append the HTML to out. Inside a RenderArena::Scope the
+ * parse tree and cmark's output buffer come from the thread's arena, so the
+ * parse makes no heap allocations of its own.
+ */
+template <typename String>
+void appendMarkdownHtml(std::string_view source, String &out) {
+  cmark_mem *mem = RenderArena::active() ? RenderArena::cmarkAllocator()
+                                         : heapCmarkAllocator();
+  cmark_parser *parser = cmark_parser_new_with_mem(kMarkdownOptions, mem);
+  cmark_parser_feed(parser, source.data(), source.size());
+  cmark_node *document = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+  char *html = cmark_render_html(document, kMarkdownOptions);
+  cmark_node_free(document);
+  out.append(html);
+  mem->free(html);
+}
+
+std::string markdownToHtml(std::string_view source) {
+  std::string html;
+  appendMarkdownHtml(source, html);
+  return html;
+}
+
+} // namespace cms
+
+#endif // CMS_MARKDOWN_HPP
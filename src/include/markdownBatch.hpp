@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef CMS_MARKDOWN_BATCH_HPP
+#define CMS_MARKDOWN_BATCH_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "markdown.hpp"
+#include "renderArena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cms {
+
+/**
+ * Renders many markdown sources in parallel, for warm-up, static export and
+ * bulk re-rendering. Each worker starts on its own contiguous share of the
+ * batch and, once that is done, steals from the shares of the others, so
+ * a few large documents do not leave the rest of the pool idle.
+ *
+ * Every document is parsed in the worker's RenderArena: the parser, tree
+ * and cmark output are bump-allocated from the thread's recycled buffer and
+ * released together after the HTML is copied out.
+ */
+class MarkdownBatchRenderer {
+public:
+  struct Result {
+    std::vector<std::string> html; // in the order of the sources
+    size_t sourceBytes = 0;
+    std::chrono::duration<double> elapsed{0};
+    std::chrono::duration<double> busy{0}; // summed over workers
+
+    double megabytesPerSecond() const {
+      return elapsed.count() > 0 ? sourceBytes / elapsed.count() / 1e6 : 0.0;
+    }
+  };
+
+  explicit MarkdownBatchRenderer(unsigned threadCount);
+
+  Result render(std::span<const std::string_view> sources) const;
+
+private:
+  // One worker's share of the batch; thieves claim from the same counter.
+  struct alignas(64) Share {
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+  };
+
+  unsigned threads;
+};
+
+MarkdownBatchRenderer::MarkdownBatchRenderer(unsigned threadCount)
+    : threads(std::max(1u, threadCount)) {}
+
+MarkdownBatchRenderer::Result
+MarkdownBatchRenderer::render(std::span<const std::string_view> sources) const {
+  Result result;
+  result.html.resize(sources.size());
+  for (auto source : sources) {
+    result.sourceBytes += source.size();
+  }
+
+  const size_t workerCount =
+      std::min<size_t>(threads, std::max<size_t>(1, sources.size()));
+  auto shares = std::make_unique<Share[]>(workerCount);
+  for (size_t w = 0; w < workerCount; ++w) {
+    shares[w].next = sources.size() * w / workerCount;
+    shares[w].end = sources.size() * (w + 1) / workerCount;
+  }
+
+  std::atomic<int64_t> busyNanos{0};
+  auto start = std::chrono::steady_clock::now();
+  auto work = [&](size_t self) {
+    auto workStart = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < workerCount; ++offset) {
+      Share &share = shares[(self + offset) % workerCount];
+      for (size_t i = share.next++; i < share.end; i = share.next++) {
+        RenderArena::Scope arena;
+        std::pmr::string html(arena.resource());
+        html.reserve(sources[i].size() * 5 / 4);
+        appendMarkdownHtml(sources[i], html);
+        result.html[i].assign(html.data(), html.size());
+      }
+    }
+    busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - workStart)
+                     .count();
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t w = 1; w < workerCount; ++w) {
+    workers.emplace_back(work, w);
+  }
+  work(0);
+  for (auto &thread : workers) {
+    thread.join();
+  }
+
+  result.elapsed = std::chrono::steady_clock::now() - start;
+  result.busy = std::chrono::nanoseconds(busyNanos.load());
+  return result;
+}
+
+} // namespace cms
+
+#endif // CMS_MARKDOWN_BATCH_HPP
@@ -0,0 +1,269 @@
+#pragma once
+
+#ifndef CMS_MEMORY_CONTENT_STORE_HPP
+#define CMS_MEMORY_CONTENT_STORE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "contentStore.hpp"
+
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/json.hpp>
+
+namespace cms {
+
+/**
+ * ContentStore holding BSON documents in memory, for benchmarks, load tests
+ * and running without a database.
+ *
+ * A fixture file is extended JSON shaped like the seed scripts:
+ *   { "localhost": { "modes": [...], "layouts": [...], "pages": [...],
+ *                    "posts": [...] }, ... }
+ */
+class MemoryContentStore : public ContentStore {
+public:
+  MemoryContentStore() = default;
+  ~MemoryContentStore() override = default;
+
+  static std::shared_ptr<MemoryContentStore>
+  fromJsonFile(const string &filePath);
+
+  // Insert or replace a document, keyed by its "id" field.
+  void put(std::string_view dbName, std::string_view collectionName,
+           bsoncxx::document::value document);
+
+  std::optional<ContentDocument>
+  getDocument(std::string_view dbName, std::string_view collectionName,
+              const ContentIdType &idType, std::string_view idValue) override;
+
+  std::optional<ContentLayout> getLayout(std::string_view dbName,
+                                         int layoutId) override;
+
+  std::optional<string> getMode(std::string_view dbName, int modeId) override;
+
+  std::vector<string> listIds(std::string_view dbName,
+                              std::string_view collectionName) override;
+
+  bool storeRenderedHtml(std::string_view dbName,
+                         std::string_view collectionName,
+                         const ContentIdType &idType, std::string_view idValue,
+                         std::string_view renderedHtml,
+                         uint64_t renderedHash) override;
+
+private:
+  using Document = std::shared_ptr<const bsoncxx::document::value>;
+  using Collection = std::map<string, Document, std::less<>>;
+  using Database = std::map<string, Collection, std::less<>>;
+
+  Document find(std::string_view dbName, std::string_view collectionName,
+                std::string_view idValue) const;
+
+  mutable std::shared_mutex mutex;
+  std::map<string, Database, std::less<>> databases;
+};
+
+std::shared_ptr<MemoryContentStore>
+MemoryContentStore::fromJsonFile(const string &filePath) {
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to open content fixture: " + filePath);
+  }
+  std::stringstream json;
+  json << file.rdbuf();
+
+  auto fixture = bsoncxx::from_json(json.str());
+  auto store = std::make_shared<MemoryContentStore>();
+  for (const auto &database : fixture.view()) {
+    if (database.type() != bsoncxx::type::k_document) {
+      continue;
+    }
+    auto dbKey = database.key();
+    std::string_view dbName(dbKey.data(), dbKey.size());
+    for (const auto &collection : database.get_document().value) {
+      if (collection.type() != bsoncxx::type::k_array) {
+        continue;
+      }
+      auto collectionKey = collection.key();
+      std::string_view collectionName(collectionKey.data(),
+                                      collectionKey.size());
+      for (const auto &document : collection.get_array().value) {
+        if (document.type() == bsoncxx::type::k_document) {
+          store->put(dbName, collectionName,
+                     bsoncxx::document::value(document.get_document().value));
+        }
+      }
+    }
+  }
+  return store;
+}
+
+void MemoryContentStore::put(std::string_view dbName,
+                             std::string_view collectionName,
+                             bsoncxx::document::value document) {
+  auto shared =
+      std::make_shared<const bsoncxx::document::value>(std::move(document));
+  string id = bsonIdString(shared->view());
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto &database = databases[string(dbName)];
+  database[string(collectionName)].insert_or_assign(std::move(id), shared);
+}
+
+MemoryContentStore::Document
+MemoryContentStore::find(std::string_view dbName,
+                         std::string_view collectionName,
+                         std::string_view idValue) const {
+  auto database = databases.find(dbName);
+  if (database == databases.end()) {
+    return nullptr;
+  }
+  auto collection = database->second.find(collectionName);
+  if (collection == database->second.end()) {
+    return nullptr;
+  }
+  auto document = collection->second.find(idValue);
+  if (document == collection->second.end()) {
+    return nullptr;
+  }
+  return document->second;
+}
+
+std::optional<ContentDocument>
+MemoryContentStore::getDocument(std::string_view dbName,
+                                std::string_view collectionName,
+                                const ContentIdType &idType,
+                                std::string_view idValue) {
+  // Both id types are keyed by their string form.
+  (void)idType;
+
+  struct Joined {
+    Document document;
+    Document layout;
+  };
+  auto joined = std::make_shared<Joined>();
+
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    joined->document = find(dbName, collectionName, idValue);
+    if (!joined->document) {
+      return std::nullopt;
+    }
+    auto documentView = joined->document->view();
+    auto modeId = bsonInt64(documentView, kDocumentModeIdField);
+    auto layoutId = bsonInt64(documentView, kDocumentLayoutIdField);
+    // Same join semantics as the MongoDB $lookup/$unwind pipeline: a
+    // document without its mode or layout is not found.
+    if (!find(dbName, "modes", std::to_string(modeId))) {
+      return std::nullopt;
+    }
+    joined->layout = find(dbName, "layouts", std::to_string(layoutId));
+  }
+
+  if (!joined->layout) {
+    return std::nullopt;
+  }
+  auto documentView = joined->document->view();
+  auto layoutView = joined->layout->view();
+  return makeContentDocument(documentView, layoutView, std::move(joined));
+}
+
+std::optional<ContentLayout>
+MemoryContentStore::getLayout(std::string_view dbName, int layoutId) {
+  Document layout;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    layout = find(dbName, "layouts", std::to_string(layoutId));
+  }
+  if (!layout) {
+    return std::nullopt;
+  }
+  auto view = layout->view();
+  return makeContentLayout(view, std::move(layout));
+}
+
+std::optional<string> MemoryContentStore::getMode(std::string_view dbName,
+                                                  int modeId) {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto mode = find(dbName, "modes", std::to_string(modeId));
+  if (!mode) {
+    return std::nullopt;
+  }
+  return string(bsonString(mode->view(), kModeNameField));
+}
+
+std::vector<string>
+MemoryContentStore::listIds(std::string_view dbName,
+                            std::string_view collectionName) {
+  std::vector<string> ids;
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto database = databases.find(dbName);
+  if (database == databases.end()) {
+    return ids;
+  }
+  auto collection = database->second.find(collectionName);
+  if (collection == database->second.end()) {
+    return ids;
+  }
+  ids.reserve(collection->second.size());
+  for (const auto &[id, document] : collection->second) {
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+bool MemoryContentStore::storeRenderedHtml(std::string_view dbName,
+                                           std::string_view collectionName,
+                                           const ContentIdType &idType,
+                                           std::string_view idValue,
+                                           std::string_view renderedHtml,
+                                           uint64_t renderedHash) {
+  using bsoncxx::builder::basic::kvp;
+  (void)idType;
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto document = find(dbName, collectionName, idValue);
+  if (!document) {
+    return false;
+  }
+  // Documents are immutable once shared; replace with an updated copy.
+  bsoncxx::builder::basic::document builder;
+  for (const auto &element : document->view()) {
+    auto key = element.key();
+    std::string_view name(key.data(), key.size());
+    if (name != kDocumentRenderedHtmlField &&
+        name != kDocumentRenderedHashField) {
+      builder.append(kvp(key, element.get_value()));
+    }
+  }
+  builder.append(
+      kvp(bsoncxx::stdx::string_view(kDocumentRenderedHtmlField.data(),
+                                     kDocumentRenderedHtmlField.size()),
+          bsoncxx::stdx::string_view(renderedHtml.data(),
+                                     renderedHtml.size())),
+      kvp(bsoncxx::stdx::string_view(kDocumentRenderedHashField.data(),
+                                     kDocumentRenderedHashField.size()),
+          bsoncxx::types::b_int64{static_cast<int64_t>(renderedHash)}));
+  databases[string(dbName)][string(collectionName)].insert_or_assign(
+      string(idValue),
+      std::make_shared<const bsoncxx::document::value>(builder.extract()));
+  return true;
+}
+
+} // namespace cms
+
+#endif // CMS_MEMORY_CONTENT_STORE_HPP
@@ -0,0 +1,294 @@
+#pragma once
+
+#ifndef CMS_METRICS_HPP
+#define CMS_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace services {
+
+using string = std::string;
+
+// Log2-bucketed latency histogram in microseconds. Recording is a couple of
+// relaxed atomic increments so it can be shared by several threads, but the
+// callers keep one per thread where they can to avoid cache line ping-pong.
+class LatencyHistogram {
+public:
+  // Bucket i counts samples <= 2^i microseconds; the last one is +Inf.
+  static constexpr size_t kBuckets = 28;
+
+  struct Snapshot {
+    std::array<uint64_t, kBuckets> buckets{};
+    uint64_t count = 0;
+    uint64_t sumMicros = 0;
+
+    void merge(const Snapshot &other);
+  };
+
+  LatencyHistogram() = default;
+  ~LatencyHistogram() = default;
+
+  void record(uint64_t micros);
+  void record(std::chrono::steady_clock::duration elapsed);
+  Snapshot snapshot() const;
+
+  static size_t bucketFor(uint64_t micros);
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sumMicros_{0};
+};
+
+void LatencyHistogram::Snapshot::merge(const Snapshot &other) {
+  for (size_t i = 0; i < kBuckets; ++i) {
+    buckets[i] += other.buckets[i];
+  }
+  count += other.count;
+  sumMicros += other.sumMicros;
+}
+
+size_t LatencyHistogram::bucketFor(uint64_t micros) {
+  // bit_width(0) == 0 and bit_width(2^k) == k + 1, so subtract one from the
+  // value first to make every bucket inclusive of its upper bound.
+  size_t index = micros == 0 ? 0 : std::bit_width(micros - 1);
+  return index < kBuckets - 1 ? index : kBuckets - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+  buckets_[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sumMicros_.fetch_add(micros, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration elapsed) {
+  auto micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  record(static_cast<uint64_t>(micros < 0 ? 0 : micros));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot result;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  result.count = count_.load(std::memory_order_relaxed);
+  result.sumMicros = sumMicros_.load(std::memory_order_relaxed);
+  return result;
+}
+
+namespace detail {
+
+// Metrics recorded on hot paths are split into shards, one per thread as far
+// as the shard count allows, each on its own cache line; a scrape sums them.
+constexpr size_t kMetricShards = 16;
+constexpr size_t kCacheLineSize = 64;
+
+size_t metricShard() {
+  static std::atomic<size_t> nextShard{0};
+  thread_local size_t shard =
+      nextShard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+  return shard;
+}
+
+} // namespace detail
+
+// Monotonic counter; add() touches only the calling thread's shard.
+class Counter {
+public:
+  void add(uint64_t amount = 1) {
+    shards[detail::metricShard()].value.fetch_add(amount,
+                                                  std::memory_order_relaxed);
+  }
+
+  uint64_t value() const;
+
+private:
+  struct alignas(detail::kCacheLineSize) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  std::array<Shard, detail::kMetricShards> shards{};
+};
+
+uint64_t Counter::value() const {
+  uint64_t total = 0;
+  for (const auto &shard : shards) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+// Up-down gauge, e.g. open sessions. A value may be raised on one thread
+// and lowered on another; only the sum over shards is meaningful.
+class Gauge {
+public:
+  void add(int64_t amount) {
+    shards[detail::metricShard()].value.fetch_add(amount,
+                                                  std::memory_order_relaxed);
+  }
+
+  int64_t value() const;
+
+private:
+  struct alignas(detail::kCacheLineSize) Shard {
+    std::atomic<int64_t> value{0};
+  };
+
+  std::array<Shard, detail::kMetricShards> shards{};
+};
+
+int64_t Gauge::value() const {
+  int64_t total = 0;
+  for (const auto &shard : shards) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+// LatencyHistogram split into per-thread shards, for latencies recorded by
+// every request; snapshot() merges them.
+class ShardedHistogram {
+public:
+  void record(uint64_t micros) {
+    shards[detail::metricShard()].histogram.record(micros);
+  }
+  void record(std::chrono::steady_clock::duration elapsed) {
+    shards[detail::metricShard()].histogram.record(elapsed);
+  }
+
+  LatencyHistogram::Snapshot snapshot() const;
+
+private:
+  struct alignas(detail::kCacheLineSize) Shard {
+    LatencyHistogram histogram;
+  };
+
+  std::array<Shard, detail::kMetricShards> shards{};
+};
+
+LatencyHistogram::Snapshot ShardedHistogram::snapshot() const {
+  LatencyHistogram::Snapshot result;
+  for (const auto &shard : shards) {
+    result.merge(shard.histogram.snapshot());
+  }
+  return result;
+}
+
+/**
+ * Prometheus text exposition helpers. Labels are passed preformatted, e.g.
+ * R"(db="localhost",command="find")", or empty for none.
+ */
+void writeMetricHeader(string &out, std::string_view name,
+                       std::string_view type, std::string_view help) {
+  fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name,
+                 help, name, type);
+}
+
+void writeSample(string &out, std::string_view name, std::string_view labels,
+                 uint64_t value) {
+  if (labels.empty()) {
+    fmt::format_to(std::back_inserter(out), "{} {}\n", name, value);
+  } else {
+    fmt::format_to(std::back_inserter(out), "{}{{{}}} {}\n", name, labels,
+                   value);
+  }
+}
+
+// A label value with backslash, double quote and newline escaped, for
+// values read from outside the process, such as thread names.
+string escapeLabelValue(std::string_view value) {
+  string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+    case '\\':
+      escaped.append("\\\\");
+      break;
+    case '"':
+      escaped.append("\\\"");
+      break;
+    case '\n':
+      escaped.append("\\n");
+      break;
+    default:
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+void writeHistogram(string &out, std::string_view name,
+                    std::string_view labels,
+                    const LatencyHistogram::Snapshot &snapshot) {
+  std::string_view separator = labels.empty() ? "" : ",";
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < LatencyHistogram::kBuckets - 1; ++i) {
+    cumulative += snapshot.buckets[i];
+    double upperSeconds = static_cast<double>(uint64_t{1} << i) / 1e6;
+    fmt::format_to(std::back_inserter(out), "{}_bucket{{{}{}le=\"{}\"}} {}\n",
+                   name, labels, separator, upperSeconds, cumulative);
+  }
+  fmt::format_to(std::back_inserter(out), "{}_bucket{{{}{}le=\"+Inf\"}} {}\n",
+                 name, labels, separator, snapshot.count);
+  double sumSeconds = static_cast<double>(snapshot.sumMicros) / 1e6;
+  if (labels.empty()) {
+    fmt::format_to(std::back_inserter(out), "{}_sum {}\n{}_count {}\n", name,
+                   sumSeconds, name, snapshot.count);
+  } else {
+    fmt::format_to(std::back_inserter(out),
+                   "{}_sum{{{}}} {}\n{}_count{{{}}} {}\n", name, labels,
+                   sumSeconds, name, labels, snapshot.count);
+  }
+}
+
+// Process-wide list of collectors rendered by the metrics endpoint.
+class MetricsRegistry {
+public:
+  using Collector = std::function<void(string &)>;
+
+  static MetricsRegistry &instance();
+
+  void addCollector(Collector collector);
+
+  // Append the output of every collector in Prometheus text format.
+  void writePrometheus(string &out);
+
+private:
+  MetricsRegistry() = default;
+
+  std::mutex mutex;
+  std::vector<Collector> collectors;
+};
+
+MetricsRegistry &MetricsRegistry::instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+void MetricsRegistry::addCollector(Collector collector) {
+  std::lock_guard<std::mutex> lock(mutex);
+  collectors.push_back(std::move(collector));
+}
+
+void MetricsRegistry::writePrometheus(string &out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto &collector : collectors) {
+    collector(out);
+  }
+}
+
+} // namespace services
+
+#endif // CMS_METRICS_HPP
@@ -0,0 +1,300 @@
+#pragma once
+
+#ifndef CMS_MONGO_CONTENT_STORE_HPP
+#define CMS_MONGO_CONTENT_STORE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "contentStore.hpp"
+#include "mongoMonitor.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <bsoncxx/builder/basic/array.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <mongocxx/change_stream.hpp>
+#include <mongocxx/client.hpp>
+#include <mongocxx/options/change_stream.hpp>
+#include <mongocxx/options/find.hpp>
+#include <mongocxx/pipeline.hpp>
+#include <mongocxx/pool.hpp>
+#include <spdlog/spdlog.h>
+
+namespace cms {
+
+// ContentStore backed by a MongoDB connection pool.
+class MongoContentStore : public ContentStore {
+public:
+  explicit MongoContentStore(std::shared_ptr<mongocxx::pool> dbPool);
+
+  ~MongoContentStore() override = default;
+
+  std::optional<ContentDocument>
+  getDocument(std::string_view dbName, std::string_view collectionName,
+              const ContentIdType &idType, std::string_view idValue) override;
+
+  std::optional<ContentLayout> getLayout(std::string_view dbName,
+                                         int layoutId) override;
+
+  std::optional<string> getMode(std::string_view dbName, int modeId) override;
+
+  std::vector<string> listIds(std::string_view dbName,
+                              std::string_view collectionName) override;
+
+  bool storeRenderedHtml(std::string_view dbName,
+                         std::string_view collectionName,
+                         const ContentIdType &idType, std::string_view idValue,
+                         std::string_view renderedHtml,
+                         uint64_t renderedHash) override;
+
+  using ChangeHandler =
+      std::function<void(std::string_view collectionName,
+                         const ContentIdType &idType, std::string_view id)>;
+
+  // Follow the database's change stream (replica sets only), calling
+  // onChange for every page or post whose content was written, until stop
+  // is set. Reconnects and resumes after errors.
+  void watchContentChanges(std::string_view dbName,
+                           const std::atomic<bool> &stop,
+                           const ChangeHandler &onChange);
+
+  std::shared_ptr<mongocxx::pool> getPool() const { return pool; }
+
+private:
+  mongocxx::pool::entry acquire();
+
+  static bsoncxx::document::value idFilter(const ContentIdType &idType,
+                                           std::string_view idValue);
+
+  static bsoncxx::stdx::string_view toBson(std::string_view value) {
+    return bsoncxx::stdx::string_view(value.data(), value.size());
+  }
+
+  std::shared_ptr<mongocxx::pool> pool;
+};
+
+MongoContentStore::MongoContentStore(std::shared_ptr<mongocxx::pool> dbPool)
+    : pool(dbPool) {
+  if (!pool) {
+    throw std::invalid_argument("Invalid or null mongodb pool");
+  }
+}
+
+bsoncxx::document::value
+MongoContentStore::idFilter(const ContentIdType &idType,
+                            std::string_view idValue) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  if (idType == ContentIdType::Integer) {
+    int idNum = 0;
+    auto [ptr, ec] =
+        std::from_chars(idValue.data(), idValue.data() + idValue.size(), idNum);
+    if (!(ec == std::errc() && ptr == idValue.data() + idValue.size())) {
+      idNum = 0;
+    }
+    return make_document(kvp(toBson(kDocumentIdField), idNum));
+  }
+  return make_document(kvp(toBson(kDocumentIdField), toBson(idValue)));
+}
+
+mongocxx::pool::entry MongoContentStore::acquire() {
+  auto acquireStart = std::chrono::steady_clock::now();
+  auto client = pool->acquire();
+  services::MongoMonitor::instance().recordPoolAcquire(
+      std::chrono::steady_clock::now() - acquireStart);
+  return client;
+}
+
+std::optional<ContentDocument>
+MongoContentStore::getDocument(std::string_view dbName,
+                               std::string_view collectionName,
+                               const ContentIdType &idType,
+                               std::string_view idValue) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  auto client = acquire();
+  auto collection = (*client)[toBson(dbName)][toBson(collectionName)];
+
+  // Match on the unique id first so the lookups join a single document.
+  mongocxx::pipeline byIdPipeline;
+  byIdPipeline.match(idFilter(idType, idValue));
+  byIdPipeline.limit(1);
+  byIdPipeline.lookup(make_document(
+      kvp("from", "modes"), kvp("localField", toBson(kDocumentModeIdField)),
+      kvp("foreignField", toBson(kDocumentIdField)), kvp("as", "mode")));
+  byIdPipeline.unwind("$mode");
+  byIdPipeline.lookup(make_document(
+      kvp("from", "layouts"), kvp("localField", toBson(kDocumentLayoutIdField)),
+      kvp("foreignField", toBson(kDocumentIdField)), kvp("as", "layout")));
+  byIdPipeline.unwind("$layout");
+
+  auto cursor = collection.aggregate(byIdPipeline);
+  for (const auto &doc : cursor) {
+    // The cursor reuses its buffer, so keep an owned copy for the views.
+    auto owned = std::make_shared<bsoncxx::document::value>(doc);
+    auto view = owned->view();
+    bsoncxx::document::view layout;
+    if (auto layoutElement = view["layout"];
+        layoutElement && layoutElement.type() == bsoncxx::type::k_document) {
+      layout = layoutElement.get_document().value;
+    }
+    return makeContentDocument(view, layout, std::move(owned));
+  }
+  return std::nullopt;
+}
+
+std::optional<ContentLayout> MongoContentStore::getLayout(
+    std::string_view dbName, int layoutId) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  auto client = acquire();
+  auto layouts = (*client)[toBson(dbName)]["layouts"];
+  auto result =
+      layouts.find_one(make_document(kvp(toBson(kDocumentIdField), layoutId)));
+  if (!result) {
+    return std::nullopt;
+  }
+  auto owned = std::make_shared<bsoncxx::document::value>(std::move(*result));
+  auto view = owned->view();
+  return makeContentLayout(view, std::move(owned));
+}
+
+std::optional<string> MongoContentStore::getMode(std::string_view dbName,
+                                                 int modeId) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  auto client = acquire();
+  auto modes = (*client)[toBson(dbName)]["modes"];
+  auto result =
+      modes.find_one(make_document(kvp(toBson(kDocumentIdField), modeId)));
+  if (!result) {
+    return std::nullopt;
+  }
+  return string(bsonString(result->view(), kModeNameField));
+}
+
+std::vector<string>
+MongoContentStore::listIds(std::string_view dbName,
+                           std::string_view collectionName) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  auto client = acquire();
+  auto collection = (*client)[toBson(dbName)][toBson(collectionName)];
+  mongocxx::options::find options;
+  options.projection(
+      make_document(kvp(toBson(kDocumentIdField), 1), kvp("_id", 0)));
+
+  std::vector<string> ids;
+  for (const auto &doc : collection.find({}, options)) {
+    ids.push_back(bsonIdString(doc));
+  }
+  return ids;
+}
+
+bool MongoContentStore::storeRenderedHtml(std::string_view dbName,
+                                          std::string_view collectionName,
+                                          const ContentIdType &idType,
+                                          std::string_view idValue,
+                                          std::string_view renderedHtml,
+                                          uint64_t renderedHash) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_document;
+
+  auto client = acquire();
+  auto collection = (*client)[toBson(dbName)][toBson(collectionName)];
+  // No check against concurrent edits: readers compare renderedHash with
+  // the current content, so HTML of an older source is simply ignored.
+  auto result = collection.update_one(
+      idFilter(idType, idValue),
+      make_document(kvp(
+          "$set",
+          make_document(kvp(toBson(kDocumentRenderedHtmlField),
+                            toBson(renderedHtml)),
+                        kvp(toBson(kDocumentRenderedHashField),
+                            bsoncxx::types::b_int64{
+                                static_cast<int64_t>(renderedHash)})))));
+  return result && result->matched_count() > 0;
+}
+
+void MongoContentStore::watchContentChanges(std::string_view dbName,
+                                            const std::atomic<bool> &stop,
+                                            const ChangeHandler &onChange) {
+  using bsoncxx::builder::basic::kvp;
+  using bsoncxx::builder::basic::make_array;
+  using bsoncxx::builder::basic::make_document;
+
+  // Only writes that touch the source; this skips our own renderedHtml
+  // updates, which would otherwise loop.
+  string contentUpdated = "updateDescription.updatedFields.";
+  contentUpdated.append(kDocumentContentField);
+  auto sourceWrites = make_document(
+      kvp("operationType",
+          make_document(kvp("$in", make_array("insert", "replace")))));
+  auto contentUpdates =
+      make_document(kvp(contentUpdated, make_document(kvp("$exists", true))));
+  mongocxx::pipeline pipeline;
+  pipeline.match(make_document(
+      kvp("ns.coll", make_document(kvp("$in", make_array("pages", "posts")))),
+      kvp("$or", make_array(sourceWrites.view(), contentUpdates.view()))));
+
+  mongocxx::options::change_stream options;
+  options.full_document("updateLookup");
+  options.max_await_time(std::chrono::seconds(1));
+
+  std::optional<bsoncxx::document::value> resumeToken;
+  while (!stop) {
+    try {
+      auto client = acquire();
+      if (resumeToken) {
+        options.resume_after(resumeToken->view());
+      }
+      auto stream = (*client)[toBson(dbName)].watch(pipeline, options);
+      spdlog::info("Watching {} for content changes", dbName);
+      while (!stop) {
+        for (const auto &event : stream) {
+          resumeToken.emplace(event["_id"].get_document().value);
+          auto fullDocument = event["fullDocument"];
+          if (!fullDocument ||
+              fullDocument.type() != bsoncxx::type::k_document) {
+            continue; // deleted before the lookup
+          }
+          auto document = fullDocument.get_document().value;
+          auto collection = event["ns"]["coll"].get_string().value;
+          auto idType = bsonField(document, kDocumentIdField).type() ==
+                                bsoncxx::type::k_string
+                            ? ContentIdType::String
+                            : ContentIdType::Integer;
+          onChange(std::string_view(collection.data(), collection.size()),
+                   idType, bsonIdString(document));
+          if (stop) {
+            break;
+          }
+        }
+      }
+    } catch (const std::exception &e) {
+      spdlog::error("Change stream on {} failed: {}", dbName, e.what());
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+    }
+  }
+}
+
+} // namespace cms
+
+#endif // CMS_MONGO_CONTENT_STORE_HPP
@@ -0,0 +1,347 @@
+#pragma once
+
+#ifndef CMS_MONGO_MONITOR_HPP
+#define CMS_MONGO_MONITOR_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <bsoncxx/document/value.hpp>
+#include <bsoncxx/document/view.hpp>
+#include <bsoncxx/json.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/events/command_failed_event.hpp>
+#include <mongocxx/events/command_started_event.hpp>
+#include <mongocxx/events/command_succeeded_event.hpp>
+#include <mongocxx/events/heartbeat_failed_event.hpp>
+#include <mongocxx/events/heartbeat_succeeded_event.hpp>
+#include <mongocxx/options/apm.hpp>
+#include <mongocxx/options/client.hpp>
+#include <spdlog/spdlog.h>
+
+namespace services {
+
+/**
+ * Collects MongoDB command monitoring (APM) events into per-thread latency
+ * histograms keyed by database, collection and command name.
+ *
+ * The driver delivers command started/succeeded/failed events synchronously
+ * on the thread that runs the operation, so each thread records into its own
+ * shard without locking. A shard's mutex is only taken to insert a key seen
+ * for the first time and by the scraper while it aggregates.
+ */
+class MongoMonitor {
+public:
+  static MongoMonitor &instance();
+
+  // Register the APM callbacks on the client options used to build the pool.
+  void install(mongocxx::options::client &clientOptions);
+
+  // Commands slower than this are logged with their pipeline/filter. Zero
+  // disables the slow command log.
+  void setSlowThreshold(std::chrono::microseconds threshold);
+
+  // Time spent waiting for a client from the connection pool.
+  void recordPoolAcquire(std::chrono::steady_clock::duration elapsed);
+
+  // Append all collected metrics in Prometheus text format.
+  void writePrometheus(string &out);
+
+private:
+  struct CommandStats {
+    LatencyHistogram latency;
+    std::atomic<uint64_t> failures{0};
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    // Key is "db\tcollection\tcommand". Nodes are stable, so entries stay
+    // valid while other keys are inserted.
+    std::unordered_map<string, CommandStats> commands;
+    LatencyHistogram heartbeats;
+    std::atomic<uint64_t> heartbeatFailures{0};
+    LatencyHistogram poolAcquire;
+  };
+
+  struct PendingCommand {
+    string key;
+    std::optional<bsoncxx::document::value> command;
+  };
+
+  MongoMonitor() = default;
+
+  Shard &localShard();
+  static std::unordered_map<int64_t, PendingCommand> &pendingCommands();
+  CommandStats &statsFor(Shard &shard, const string &key);
+
+  void onCommandStarted(const mongocxx::events::command_started_event &event);
+  void
+  onCommandSucceeded(const mongocxx::events::command_succeeded_event &event);
+  void onCommandFailed(const mongocxx::events::command_failed_event &event);
+
+  void logSlowCommand(const PendingCommand &pending, std::string_view name,
+                      int64_t micros) const;
+
+  static string escapeLabel(std::string_view value);
+
+  std::mutex shardsMutex;
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::atomic<int64_t> slowThresholdMicros{0};
+};
+
+MongoMonitor &MongoMonitor::instance() {
+  static MongoMonitor monitor;
+  return monitor;
+}
+
+MongoMonitor::Shard &MongoMonitor::localShard() {
+  // Shards are never released; the process has a fixed set of IO and driver
+  // monitoring threads.
+  thread_local Shard *shard = [this] {
+    auto owned = std::make_unique<Shard>();
+    Shard *raw = owned.get();
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    shards.push_back(std::move(owned));
+    return raw;
+  }();
+  return *shard;
+}
+
+MongoMonitor::CommandStats &MongoMonitor::statsFor(Shard &shard,
+                                                   const string &key) {
+  // Only the owning thread inserts, so a lock-free lookup is safe here.
+  auto found = shard.commands.find(key);
+  if (found != shard.commands.end()) {
+    return found->second;
+  }
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.commands.try_emplace(key).first->second;
+}
+
+void MongoMonitor::install(mongocxx::options::client &clientOptions) {
+  mongocxx::options::apm apm;
+  apm.on_command_started(
+      [this](const mongocxx::events::command_started_event &event) {
+        onCommandStarted(event);
+      });
+  apm.on_command_succeeded(
+      [this](const mongocxx::events::command_succeeded_event &event) {
+        onCommandSucceeded(event);
+      });
+  apm.on_command_failed(
+      [this](const mongocxx::events::command_failed_event &event) {
+        onCommandFailed(event);
+      });
+  apm.on_heartbeat_succeeded(
+      [this](const mongocxx::events::heartbeat_succeeded_event &event) {
+        localShard().heartbeats.record(
+            static_cast<uint64_t>(std::max<int64_t>(0, event.duration())));
+      });
+  apm.on_heartbeat_failed(
+      [this](const mongocxx::events::heartbeat_failed_event &event) {
+        localShard().heartbeatFailures.fetch_add(1, std::memory_order_relaxed);
+        spdlog::warn("mongodb heartbeat failed {}:{} => {}", event.host(),
+                     event.port(), event.message());
+      });
+  clientOptions.apm_opts(apm);
+}
+
+void MongoMonitor::setSlowThreshold(std::chrono::microseconds threshold) {
+  slowThresholdMicros.store(threshold.count(), std::memory_order_relaxed);
+}
+
+void MongoMonitor::recordPoolAcquire(
+    std::chrono::steady_clock::duration elapsed) {
+  localShard().poolAcquire.record(elapsed);
+}
+
+// Commands in flight on this thread, keyed by driver request id. Started and
+// succeeded/failed events for a pooled client arrive on the calling thread.
+std::unordered_map<int64_t, MongoMonitor::PendingCommand> &
+MongoMonitor::pendingCommands() {
+  thread_local std::unordered_map<int64_t, PendingCommand> pending;
+  return pending;
+}
+
+void MongoMonitor::onCommandStarted(
+    const mongocxx::events::command_started_event &event) {
+  auto command = event.command();
+  auto commandName = event.command_name();
+
+  // For CRUD and aggregate commands the first field holds the collection.
+  std::string_view collection;
+  if (auto target = command[commandName];
+      target && target.type() == bsoncxx::type::k_string) {
+    auto value = target.get_string().value;
+    collection = std::string_view(value.data(), value.size());
+  }
+
+  auto databaseName = event.database_name();
+  PendingCommand pending;
+  pending.key.reserve(databaseName.size() + collection.size() +
+                      commandName.size() + 2);
+  pending.key.append(databaseName.data(), databaseName.size());
+  pending.key.push_back('\t');
+  pending.key.append(collection);
+  pending.key.push_back('\t');
+  pending.key.append(commandName.data(), commandName.size());
+
+  if (slowThresholdMicros.load(std::memory_order_relaxed) > 0) {
+    pending.command.emplace(command);
+  }
+  pendingCommands().insert_or_assign(event.request_id(), std::move(pending));
+}
+
+void MongoMonitor::onCommandSucceeded(
+    const mongocxx::events::command_succeeded_event &event) {
+  auto &pending = pendingCommands();
+  auto found = pending.find(event.request_id());
+  if (found == pending.end()) {
+    return;
+  }
+
+  int64_t micros = std::max<int64_t>(0, event.duration());
+  statsFor(localShard(), found->second.key)
+      .latency.record(static_cast<uint64_t>(micros));
+
+  int64_t threshold = slowThresholdMicros.load(std::memory_order_relaxed);
+  if (threshold > 0 && micros >= threshold) {
+    auto name = event.command_name();
+    logSlowCommand(found->second, std::string_view(name.data(), name.size()),
+                   micros);
+  }
+  pending.erase(found);
+}
+
+void MongoMonitor::onCommandFailed(
+    const mongocxx::events::command_failed_event &event) {
+  auto &pending = pendingCommands();
+  auto found = pending.find(event.request_id());
+  if (found == pending.end()) {
+    return;
+  }
+
+  auto &stats = statsFor(localShard(), found->second.key);
+  stats.latency.record(
+      static_cast<uint64_t>(std::max<int64_t>(0, event.duration())));
+  stats.failures.fetch_add(1, std::memory_order_relaxed);
+  pending.erase(found);
+}
+
+void MongoMonitor::logSlowCommand(const PendingCommand &pending,
+                                  std::string_view name, int64_t micros) const {
+  string detail;
+  if (pending.command) {
+    auto view = pending.command->view();
+    if (auto pipeline = view["pipeline"]) {
+      detail = bsoncxx::to_json(pipeline.get_array().value);
+    } else if (auto filter = view["filter"];
+               filter && filter.type() == bsoncxx::type::k_document) {
+      detail = bsoncxx::to_json(filter.get_document().value);
+    }
+  }
+  spdlog::warn("slow mongodb {} ({}) {:.3f} ms: {}", name, pending.key,
+               static_cast<double>(micros) / 1000.0, detail);
+}
+
+string MongoMonitor::escapeLabel(std::string_view value) {
+  string result;
+  result.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      result.push_back('\\');
+      result.push_back(c);
+    } else if (c == '\n') {
+      result.append("\\n");
+    } else {
+      result.push_back(c);
+    }
+  }
+  return result;
+}
+
+void MongoMonitor::writePrometheus(string &out) {
+  using Key = std::tuple<string, string, string>;
+  std::map<Key, std::pair<LatencyHistogram::Snapshot, uint64_t>> commands;
+  LatencyHistogram::Snapshot heartbeats;
+  LatencyHistogram::Snapshot poolAcquire;
+  uint64_t heartbeatFailures = 0;
+
+  {
+    std::lock_guard<std::mutex> shardsLock(shardsMutex);
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      for (auto &[key, stats] : shard->commands) {
+        auto first = key.find('\t');
+        auto second = key.find('\t', first + 1);
+        Key parts{key.substr(0, first),
+                  key.substr(first + 1, second - first - 1),
+                  key.substr(second + 1)};
+        auto &entry = commands[parts];
+        entry.first.merge(stats.latency.snapshot());
+        entry.second += stats.failures.load(std::memory_order_relaxed);
+      }
+      heartbeats.merge(shard->heartbeats.snapshot());
+      poolAcquire.merge(shard->poolAcquire.snapshot());
+      heartbeatFailures +=
+          shard->heartbeatFailures.load(std::memory_order_relaxed);
+    }
+  }
+
+  writeMetricHeader(out, "cms_mongodb_command_duration_seconds", "histogram",
+                    "MongoDB command round trip time.");
+  for (const auto &[key, entry] : commands) {
+    auto labels =
+        fmt::format(R"(db="{}",collection="{}",command="{}")",
+                    escapeLabel(std::get<0>(key)), escapeLabel(std::get<1>(key)),
+                    escapeLabel(std::get<2>(key)));
+    writeHistogram(out, "cms_mongodb_command_duration_seconds", labels,
+                   entry.first);
+  }
+
+  writeMetricHeader(out, "cms_mongodb_command_failures_total", "counter",
+                    "MongoDB commands that returned an error.");
+  for (const auto &[key, entry] : commands) {
+    auto labels =
+        fmt::format(R"(db="{}",collection="{}",command="{}")",
+                    escapeLabel(std::get<0>(key)), escapeLabel(std::get<1>(key)),
+                    escapeLabel(std::get<2>(key)));
+    writeSample(out, "cms_mongodb_command_failures_total", labels,
+                entry.second);
+  }
+
+  writeMetricHeader(out, "cms_mongodb_pool_acquire_seconds", "histogram",
+                    "Time spent waiting for a pooled MongoDB client.");
+  writeHistogram(out, "cms_mongodb_pool_acquire_seconds", "", poolAcquire);
+
+  writeMetricHeader(out, "cms_mongodb_heartbeat_duration_seconds",
+                    "histogram", "MongoDB server monitoring heartbeat time.");
+  writeHistogram(out, "cms_mongodb_heartbeat_duration_seconds", "",
+                 heartbeats);
+
+  writeMetricHeader(out, "cms_mongodb_heartbeat_failures_total", "counter",
+                    "MongoDB server monitoring heartbeats that failed.");
+  writeSample(out, "cms_mongodb_heartbeat_failures_total", "",
+              heartbeatFailures);
+}
+
+} // namespace services
+
+#endif // CMS_MONGO_MONITOR_HPP
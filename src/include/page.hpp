@@ -57,35 +57,55 @@ using string = std::string;
 
 class Page {
 public:
-  explicit Page(std::shared_ptr<mongocxx::pool> dbPool,
-                std::shared_ptr<Content> contentPtr);
+  explicit Page(std::shared_ptr<Content> contentPtr);
 
   // Default destructor
   ~Page() = default;
 
-  string getPage(const std::string_view &host,
-                 const bsoncxx::stdx::string_view &dbName,
-                 const string &pageId);
+  RenderedPage getPage(const std::string_view &host,
+                       const bsoncxx::stdx::string_view &dbName,
+                       const string &pageId);
+
+  // Layout head sent before the page is fetched; see Content::renderHead.
+  std::optional<RenderedPage>
+  getPageHead(const bsoncxx::stdx::string_view &dbName, const string &pageId);
+
+  RenderedPage getPageTail(const RenderedPage &head,
+                           const std::string_view &host,
+                           const bsoncxx::stdx::string_view &dbName,
+                           const string &pageId);
 
 private:
-  std::shared_ptr<mongocxx::pool> pool;
   std::shared_ptr<Content> content;
   ContentIdType idType;
 };
 
-Page::Page(std::shared_ptr<mongocxx::pool> dbPool,
-           std::shared_ptr<Content> contentPtr)
-    : pool(dbPool), content(contentPtr), idType(ContentIdType::String) {
-  if (!pool) {
-    throw std::invalid_argument("Invalid or null mongodb pool");
+Page::Page(std::shared_ptr<Content> contentPtr)
+    : content(contentPtr), idType(ContentIdType::String) {
+  if (!content) {
+    throw std::invalid_argument("Invalid or null content");
   }
 }
 
-string Page::getPage(const std::string_view &host,
-                     const bsoncxx::stdx::string_view &dbName,
-                     const string &pageId) {
+RenderedPage Page::getPage(const std::string_view &host,
+                           const bsoncxx::stdx::string_view &dbName,
+                           const string &pageId) {
   return content->render(host, dbName, "page", kPagesCollection, idType,
-                         kIdField, pageId, kTitleField);
+                         pageId);
+}
+
+std::optional<RenderedPage>
+Page::getPageHead(const bsoncxx::stdx::string_view &dbName,
+                  const string &pageId) {
+  return content->renderHead(dbName, "page", pageId);
+}
+
+RenderedPage Page::getPageTail(const RenderedPage &head,
+                               const std::string_view &host,
+                               const bsoncxx::stdx::string_view &dbName,
+                               const string &pageId) {
+  return content->renderTail(head, host, dbName, "page", kPagesCollection,
+                             idType, pageId);
 }
 
 } // namespace cms
@@ -60,36 +60,55 @@ using string = std::string;
 
 class Post {
 public:
-  // Constructor taking a shared_ptr to ConnectionPool
-  explicit Post(std::shared_ptr<mongocxx::pool> dbPool,
-                std::shared_ptr<Content> contentPtr);
+  // Constructor taking a shared_ptr to Content
+  explicit Post(std::shared_ptr<Content> contentPtr);
 
   // Default destructor
   ~Post() = default;
 
-  string getPost(const std::string_view &host,
-                 const bsoncxx::stdx::string_view &dbName, int postId);
+  RenderedPage getPost(const std::string_view &host,
+                       const bsoncxx::stdx::string_view &dbName, int postId);
+
+  // Layout head sent before the post is fetched; see Content::renderHead.
+  std::optional<RenderedPage>
+  getPostHead(const bsoncxx::stdx::string_view &dbName, int postId);
+
+  RenderedPage getPostTail(const RenderedPage &head,
+                           const std::string_view &host,
+                           const bsoncxx::stdx::string_view &dbName,
+                           int postId);
 
 private:
-  std::shared_ptr<mongocxx::pool> pool;
   std::shared_ptr<Content> content;
   ContentIdType idType;
 };
 
-Post::Post(std::shared_ptr<mongocxx::pool> dbPool,
-           std::shared_ptr<Content> contentPtr)
-    : pool(dbPool), content(contentPtr), idType(ContentIdType::Integer) {
-  if (!pool) {
-    throw std::invalid_argument("Invalid or null mongodb pool");
+Post::Post(std::shared_ptr<Content> contentPtr)
+    : content(contentPtr), idType(ContentIdType::Integer) {
+  if (!content) {
+    throw std::invalid_argument("Invalid or null content");
   }
 }
 
-string Post::getPost(const std::string_view &host,
-                     const bsoncxx::stdx::string_view &dbName,
-                     const int postId) {
+RenderedPage Post::getPost(const std::string_view &host,
+                           const bsoncxx::stdx::string_view &dbName,
+                           const int postId) {
   const string idValue = std::to_string(postId);
   return content->render(host, dbName, "post", kPostsCollection, idType,
-                         kIdField, idValue, kTitleField);
+                         idValue);
+}
+
+std::optional<RenderedPage>
+Post::getPostHead(const bsoncxx::stdx::string_view &dbName, int postId) {
+  return content->renderHead(dbName, "post", std::to_string(postId));
+}
+
+RenderedPage Post::getPostTail(const RenderedPage &head,
+                               const std::string_view &host,
+                               const bsoncxx::stdx::string_view &dbName,
+                               int postId) {
+  return content->renderTail(head, host, dbName, "post", kPostsCollection,
+                             idType, std::to_string(postId));
 }
 
 } // namespace cms
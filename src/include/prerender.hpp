@@ -0,0 +1,142 @@
+#pragma once
+
+#ifndef CMS_PRERENDER_HPP
+#define CMS_PRERENDER_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "contentStore.hpp"
+#include "markdown.hpp"
+#include "markdownBatch.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+/***
+###############################################################################
+# Constants
+###############################################################################
+***/
+#include "include/constants.h"
+
+namespace cms {
+
+/**
+ * Render-on-write for markdown documents: renders the content once and
+ * stores it back as renderedHtml with its markdownHash, which
+ * Content::renderDocument then serves instead of running cmark.
+ */
+class Prerenderer {
+public:
+  explicit Prerenderer(
+      std::shared_ptr<ContentStore> contentStore,
+      unsigned threadCount = std::thread::hardware_concurrency());
+
+  // Render one document when its stored HTML is missing or stale; returns
+  // true when new HTML was stored.
+  bool prerender(std::string_view dbName, std::string_view collectionName,
+                 const ContentIdType &idType, std::string_view idValue);
+
+  // Every page and post of the databases, rendered as one parallel batch;
+  // returns the documents stored.
+  size_t prerenderAll(const std::vector<std::string_view> &databases);
+
+private:
+  std::shared_ptr<ContentStore> store;
+  MarkdownBatchRenderer batch;
+};
+
+Prerenderer::Prerenderer(std::shared_ptr<ContentStore> contentStore,
+                         unsigned threadCount)
+    : store(contentStore), batch(threadCount) {
+  if (!store) {
+    throw std::invalid_argument("Invalid or null content store");
+  }
+}
+
+bool Prerenderer::prerender(std::string_view dbName,
+                            std::string_view collectionName,
+                            const ContentIdType &idType,
+                            std::string_view idValue) {
+  auto document = store->getDocument(dbName, collectionName, idType, idValue);
+  if (!document || document->modeId != MODE_MARKDOWN) {
+    return false;
+  }
+  auto hash = markdownHash(document->content);
+  if (!document->renderedHtml.empty() && document->renderedHash == hash) {
+    return false;
+  }
+  auto html = markdownToHtml(document->content);
+  if (!store->storeRenderedHtml(dbName, collectionName, idType, idValue, html,
+                                hash)) {
+    return false;
+  }
+  spdlog::info("Pre-rendered {}.{} ({})", dbName, collectionName, idValue);
+  return true;
+}
+
+size_t
+Prerenderer::prerenderAll(const std::vector<std::string_view> &databases) {
+  struct Pending {
+    std::string_view dbName;
+    std::string_view collectionName;
+    ContentIdType idType;
+    string id;
+    ContentDocument document;
+    uint64_t hash;
+  };
+  std::vector<Pending> pending;
+  auto collect = [&](std::string_view dbName, std::string_view collectionName,
+                     ContentIdType idType) {
+    for (auto &id : store->listIds(dbName, collectionName)) {
+      auto document = store->getDocument(dbName, collectionName, idType, id);
+      if (!document || document->modeId != MODE_MARKDOWN) {
+        continue;
+      }
+      auto hash = markdownHash(document->content);
+      if (document->renderedHtml.empty() || document->renderedHash != hash) {
+        pending.push_back(Pending{dbName, collectionName, idType,
+                                  std::move(id), std::move(*document), hash});
+      }
+    }
+  };
+  for (auto dbName : databases) {
+    collect(dbName, "pages", ContentIdType::String);
+    collect(dbName, "posts", ContentIdType::Integer);
+  }
+
+  std::vector<std::string_view> sources;
+  sources.reserve(pending.size());
+  for (const auto &document : pending) {
+    sources.push_back(document.document.content);
+  }
+  auto rendered = batch.render(sources);
+  spdlog::info("Rendered {} markdown documents in {:.3f}s ({:.1f} MB/s)",
+               sources.size(), rendered.elapsed.count(),
+               rendered.megabytesPerSecond());
+
+  size_t stored = 0;
+  for (size_t i = 0; i < pending.size(); ++i) {
+    const auto &document = pending[i];
+    if (store->storeRenderedHtml(document.dbName, document.collectionName,
+                                 document.idType, document.id,
+                                 rendered.html[i], document.hash)) {
+      spdlog::info("Pre-rendered {}.{} ({})", document.dbName,
+                   document.collectionName, document.id);
+      ++stored;
+    }
+  }
+  return stored;
+}
+
+} // namespace cms
+
+#endif // CMS_PRERENDER_HPP
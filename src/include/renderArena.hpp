@@ -0,0 +1,176 @@
+#pragma once
+
+#ifndef CMS_RENDER_ARENA_HPP
+#define CMS_RENDER_ARENA_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+#include <cmark.h>
+
+namespace cms {
+
+/**
+ * Scratch memory for rendering one page, carved from a buffer each thread
+ * keeps across requests. A render's temporaries (markdown parse tree, HTML
+ * output, body assembly) are bump-allocated and released together when the
+ * scope ends, instead of going through malloc one by one. The buffer grows
+ * to the largest render seen on the thread, up to kMaxCapacity; anything
+ * beyond it spills to the heap for that render only.
+ */
+class RenderArena {
+public:
+  static constexpr size_t kInitialCapacity = 64 << 10;
+  static constexpr size_t kMaxCapacity = 8 << 20;
+
+  // Opens a render on the calling thread's arena. Nested scopes share the
+  // outermost one, so helpers can open a scope unconditionally.
+  class Scope {
+  public:
+    Scope();
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    std::pmr::memory_resource *resource() const { return resource_; }
+
+  private:
+    RenderArena &arena;
+    std::pmr::memory_resource *resource_;
+    bool outermost;
+  };
+
+  // Memory resource of the calling thread's open scope, or null.
+  static std::pmr::memory_resource *active();
+
+  // cmark allocator over the open scope's resource; only valid while one is
+  // open. free() is a no-op: the scope releases everything at once.
+  static cmark_mem *cmarkAllocator();
+
+private:
+  // Heap upstream that records how far a render overflowed the buffer.
+  class Overflow : public std::pmr::memory_resource {
+  public:
+    size_t bytes = 0;
+
+  private:
+    void *do_allocate(size_t size, size_t alignment) override {
+      bytes += size;
+      return std::pmr::new_delete_resource()->allocate(size, alignment);
+    }
+    void do_deallocate(void *pointer, size_t size, size_t alignment) override {
+      std::pmr::new_delete_resource()->deallocate(pointer, size, alignment);
+    }
+    bool do_is_equal(const memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+  };
+
+  static RenderArena &local();
+
+  std::unique_ptr<std::byte[]> buffer;
+  size_t capacity = 0;
+  std::optional<Overflow> overflow;
+  std::optional<std::pmr::monotonic_buffer_resource> resource;
+};
+
+RenderArena &RenderArena::local() {
+  thread_local RenderArena arena;
+  return arena;
+}
+
+std::pmr::memory_resource *RenderArena::active() {
+  auto &arena = local();
+  return arena.resource ? &*arena.resource : nullptr;
+}
+
+RenderArena::Scope::Scope() : arena(local()), outermost(!arena.resource) {
+  if (outermost) {
+    if (!arena.buffer) {
+      arena.capacity = kInitialCapacity;
+      arena.buffer = std::make_unique<std::byte[]>(arena.capacity);
+    }
+    arena.overflow.emplace();
+    arena.resource.emplace(arena.buffer.get(), arena.capacity,
+                           &*arena.overflow);
+  }
+  resource_ = &*arena.resource;
+}
+
+RenderArena::Scope::~Scope() {
+  if (!outermost) {
+    return;
+  }
+  size_t spilled = arena.overflow->bytes;
+  arena.resource.reset();
+  arena.overflow.reset();
+  if (spilled > 0 && arena.capacity < kMaxCapacity) {
+    // Next render on this thread fits without spilling.
+    size_t wanted = arena.capacity + spilled;
+    size_t grown = arena.capacity;
+    while (grown < wanted && grown < kMaxCapacity) {
+      grown *= 2;
+    }
+    arena.capacity = std::min(grown, kMaxCapacity);
+    arena.buffer = std::make_unique<std::byte[]>(arena.capacity);
+  }
+}
+
+namespace detail {
+
+// cmark reallocs without passing the old size, so each block carries it.
+constexpr size_t kArenaBlockHeader = alignof(std::max_align_t);
+
+void *arenaAllocate(size_t size) {
+  try {
+    auto *block = static_cast<std::byte *>(RenderArena::active()->allocate(
+        size + kArenaBlockHeader, alignof(std::max_align_t)));
+    std::memcpy(block, &size, sizeof(size));
+    return block + kArenaBlockHeader;
+  } catch (...) {
+    std::abort(); // what cmark's own allocator does on failure
+  }
+}
+
+void *arenaCalloc(size_t count, size_t size) {
+  void *pointer = arenaAllocate(count * size);
+  std::memset(pointer, 0, count * size);
+  return pointer;
+}
+
+void *arenaRealloc(void *pointer, size_t size) {
+  void *grown = arenaAllocate(size);
+  if (pointer) {
+    size_t previous;
+    std::memcpy(&previous,
+                static_cast<std::byte *>(pointer) - kArenaBlockHeader,
+                sizeof(previous));
+    std::memcpy(grown, pointer, std::min(previous, size));
+  }
+  return grown;
+}
+
+void arenaFree(void *) {}
+
+} // namespace detail
+
+cmark_mem *RenderArena::cmarkAllocator() {
+  static cmark_mem allocator{detail::arenaCalloc, detail::arenaRealloc,
+                             detail::arenaFree};
+  return &allocator;
+}
+
+} // namespace cms
+
+#endif // CMS_RENDER_ARENA_HPP
@@ -0,0 +1,532 @@
+#pragma once
+
+#ifndef CMS_REQUEST_TRACE_HPP
+#define CMS_REQUEST_TRACE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace services {
+
+/**
+ * Phases of serving one request, in the order a cache miss goes through
+ * them. Each is stamped when it ends: cache_lookup when the page cache has
+ * answered, mongo_fetch when the document arrived, render when markdown was
+ * turned into the body, replace when the layout was filled in.
+ */
+enum class RequestPhase : uint8_t {
+  Accepted, // the connection was accepted, or a kept-alive one began reading
+  HeaderRead,
+  Routed,
+  CacheLookup,
+  Fetched,
+  Rendered,
+  Replaced,
+  FirstByte,
+  LastByte
+};
+
+constexpr size_t kRequestPhaseCount = 9;
+
+constexpr std::array<std::string_view, kRequestPhaseCount> kRequestPhaseNames{
+    "accept", "header_read", "route",     "cache_lookup", "mongo_fetch",
+    "render", "replace",     "first_byte", "last_byte"};
+
+/**
+ * Timestamps of one request's phases and what it asked for, in fixed-size
+ * storage so tracing never allocates. A phase keeps its first stamp, and
+ * phases a request skips (a cache hit fetches nothing) stay unset.
+ */
+class RequestTrace {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kTargetSize = 128;
+
+  // Makes a trace the calling thread's active one, so the content layer
+  // can mark phases without the trace being passed down to it.
+  class Scope {
+  public:
+    explicit Scope(RequestTrace &trace);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    RequestTrace *previous;
+  };
+
+  // Forget the previous request and stamp Accepted.
+  void start(Clock::time_point accepted);
+
+  // Method and target, the target truncated to kTargetSize bytes. The
+  // method must outlive the trace, as beast's verb strings do.
+  void describe(std::string_view method, std::string_view target);
+
+  void mark(RequestPhase phase) {
+    auto &stamp = stamps[static_cast<size_t>(phase)];
+    if (stamp == Clock::time_point{}) {
+      stamp = Clock::now();
+      if (auto *beacon = phaseBeacon()) {
+        beacon->store(static_cast<uint8_t>(phase), std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Mark a phase of the calling thread's active trace, if there is one.
+  static void markActive(RequestPhase phase);
+
+  // Where the calling thread publishes the last phase it marked, for the
+  // IO watchdog to read while the thread is stuck; null when not watched.
+  static std::atomic<uint8_t> *&phaseBeacon();
+
+  bool reached(RequestPhase phase) const {
+    return stamps[static_cast<size_t>(phase)] != Clock::time_point{};
+  }
+  Clock::time_point at(RequestPhase phase) const {
+    return stamps[static_cast<size_t>(phase)];
+  }
+
+  // Server time: from the request being read to its last byte written.
+  Clock::duration total() const;
+
+  std::string_view method() const { return method_; }
+  std::string_view target() const { return {target_.data(), targetSize}; }
+
+  // The reached phases ordered by time; returns how many there are.
+  size_t ordered(std::array<RequestPhase, kRequestPhaseCount> &out) const;
+
+private:
+  static RequestTrace *&active();
+
+  std::array<Clock::time_point, kRequestPhaseCount> stamps{};
+  std::string_view method_;
+  std::array<char, kTargetSize> target_;
+  size_t targetSize = 0;
+};
+
+RequestTrace *&RequestTrace::active() {
+  thread_local RequestTrace *trace = nullptr;
+  return trace;
+}
+
+std::atomic<uint8_t> *&RequestTrace::phaseBeacon() {
+  thread_local std::atomic<uint8_t> *beacon = nullptr;
+  return beacon;
+}
+
+RequestTrace::Scope::Scope(RequestTrace &trace) : previous(active()) {
+  active() = &trace;
+}
+
+RequestTrace::Scope::~Scope() { active() = previous; }
+
+void RequestTrace::markActive(RequestPhase phase) {
+  if (auto *trace = active()) {
+    trace->mark(phase);
+  }
+}
+
+void RequestTrace::start(Clock::time_point accepted) {
+  stamps.fill(Clock::time_point{});
+  stamps[static_cast<size_t>(RequestPhase::Accepted)] = accepted;
+  if (auto *beacon = phaseBeacon()) {
+    beacon->store(static_cast<uint8_t>(RequestPhase::Accepted),
+                  std::memory_order_relaxed);
+  }
+  method_ = {};
+  targetSize = 0;
+}
+
+void RequestTrace::describe(std::string_view method, std::string_view target) {
+  method_ = method;
+  targetSize = std::min(target.size(), kTargetSize);
+  std::copy_n(target.data(), targetSize, target_.data());
+}
+
+RequestTrace::Clock::duration RequestTrace::total() const {
+  if (!reached(RequestPhase::HeaderRead) || !reached(RequestPhase::LastByte)) {
+    return Clock::duration::zero();
+  }
+  return at(RequestPhase::LastByte) - at(RequestPhase::HeaderRead);
+}
+
+size_t
+RequestTrace::ordered(std::array<RequestPhase, kRequestPhaseCount> &out) const {
+  size_t count = 0;
+  for (size_t i = 0; i < kRequestPhaseCount; ++i) {
+    auto phase = static_cast<RequestPhase>(i);
+    if (!reached(phase)) {
+      continue;
+    }
+    // Insertion sort: a streamed page writes its first byte before the
+    // fetch, so stamp order can differ from phase order.
+    size_t position = count++;
+    while (position > 0 && at(out[position - 1]) > at(phase)) {
+      out[position] = out[position - 1];
+      --position;
+    }
+    out[position] = phase;
+  }
+  return count;
+}
+
+/**
+ * What happens to a finished request's trace: a structured warning when it
+ * took longer than the slow threshold, and optionally a span in OTLP JSON
+ * (one ExportTraceServiceRequest per line, as read by the OpenTelemetry
+ * collector's otlpjsonfile receiver) for slow requests and a sample of the
+ * rest. Spans are written off the IO threads the way the access log is:
+ * the trace is copied into the thread's own ring, or dropped and counted
+ * when the ring is full, and a background writer formats and writes them.
+ */
+class RequestTracer {
+public:
+  struct Options {
+    std::chrono::milliseconds slowThreshold{500}; // zero disables the log
+    std::string spanFile;                         // empty disables spans
+    double sampleRate = 0.01; // of requests that are not slow
+    size_t ringCapacity = 256; // spans per thread, a power of two
+    std::chrono::milliseconds flushInterval{200};
+  };
+
+  static RequestTracer &instance();
+
+  ~RequestTracer();
+
+  // Call before serving; options are read without locking afterwards.
+  void configure(Options configured);
+
+  // Write out the queued spans and stop the writer.
+  void close();
+
+  // The route must outlive the tracer, as request_route_names do.
+  void finish(const RequestTrace &trace, std::string_view route,
+              unsigned status);
+
+  // Spans written and dropped, in Prometheus text format.
+  void writeMetrics(std::string &out) const;
+
+private:
+  // A finished trace waiting for the writer.
+  struct PendingSpan {
+    RequestTrace trace;
+    std::string_view route;
+    unsigned status = 0;
+  };
+
+  struct Ring {
+    explicit Ring(size_t capacity) : slots(capacity) {}
+
+    std::vector<PendingSpan> slots;
+    alignas(detail::kCacheLineSize) std::atomic<size_t> head{0}; // producer
+    alignas(detail::kCacheLineSize) std::atomic<size_t> tail{0}; // writer
+  };
+
+  RequestTracer() = default;
+
+  void logSlow(const RequestTrace &trace, std::string_view route,
+               unsigned status) const;
+  void queueSpan(const RequestTrace &trace, std::string_view route,
+                 unsigned status);
+  Ring &localRing();
+  void run();
+  void drain();
+  static void formatSpan(const PendingSpan &span,
+                         std::chrono::nanoseconds clockOffset,
+                         fmt::memory_buffer &out);
+
+  Options options;
+  std::atomic<bool> spansEnabled{false};
+  std::mutex ringsMutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+
+  // Writer thread state.
+  std::thread writer;
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> file{nullptr, std::fclose};
+  fmt::memory_buffer batch;
+
+  Counter written;
+  Counter dropped;
+};
+
+namespace detail {
+
+double milliseconds(std::chrono::steady_clock::duration elapsed) {
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+std::mt19937_64 &traceRandom() {
+  thread_local std::mt19937_64 random{std::random_device{}()};
+  return random;
+}
+
+// Lowercase hex of random bytes, as OTLP JSON encodes trace and span ids.
+template <size_t Bytes> std::array<char, Bytes * 2> randomTraceId() {
+  std::array<char, Bytes * 2> id;
+  constexpr std::string_view kDigits = "0123456789abcdef";
+  for (size_t i = 0; i < id.size(); i += 16) {
+    uint64_t bits = traceRandom()();
+    for (size_t j = i; j < std::min(i + 16, id.size()); ++j, bits >>= 4) {
+      id[j] = kDigits[bits & 0xf];
+    }
+  }
+  return id;
+}
+
+void appendJsonString(fmt::memory_buffer &out, std::string_view text) {
+  out.push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      fmt::format_to(std::back_inserter(out), "\\u{:04x}", c);
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+}
+
+} // namespace detail
+
+RequestTracer &RequestTracer::instance() {
+  static RequestTracer tracer;
+  return tracer;
+}
+
+RequestTracer::~RequestTracer() { close(); }
+
+void RequestTracer::configure(Options configured) {
+  options = std::move(configured);
+  options.ringCapacity =
+      std::bit_ceil(std::max<size_t>(options.ringCapacity, 2));
+  if (options.spanFile.empty()) {
+    return;
+  }
+  file.reset(std::fopen(options.spanFile.c_str(), "a"));
+  if (!file) {
+    spdlog::error("cannot open span file {}", options.spanFile);
+    return;
+  }
+  stopping = false;
+  spansEnabled = true;
+  writer = std::thread([this] { run(); });
+}
+
+void RequestTracer::close() {
+  if (!spansEnabled.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+  file.reset();
+}
+
+void RequestTracer::finish(const RequestTrace &trace, std::string_view route,
+                           unsigned status) {
+  bool slow = options.slowThreshold.count() > 0 &&
+              trace.total() >= options.slowThreshold;
+  if (slow) {
+    logSlow(trace, route, status);
+  }
+  if (spansEnabled.load(std::memory_order_relaxed) &&
+      (slow || std::generate_canonical<double, 32>(detail::traceRandom()) <
+                   options.sampleRate)) {
+    queueSpan(trace, route, status);
+  }
+}
+
+void RequestTracer::logSlow(const RequestTrace &trace, std::string_view route,
+                            unsigned status) const {
+  fmt::memory_buffer line;
+  fmt::format_to(std::back_inserter(line),
+                 "slow request method={} target={} route={} status={} "
+                 "total_ms={:.3f}",
+                 trace.method(), trace.target(), route, status,
+                 detail::milliseconds(trace.total()));
+  // Each phase as the time since the one before it.
+  std::array<RequestPhase, kRequestPhaseCount> phases;
+  size_t count = trace.ordered(phases);
+  for (size_t i = 1; i < count; ++i) {
+    fmt::format_to(std::back_inserter(line), " {}_ms={:.3f}",
+                   kRequestPhaseNames[static_cast<size_t>(phases[i])],
+                   detail::milliseconds(trace.at(phases[i]) -
+                                        trace.at(phases[i - 1])));
+  }
+  spdlog::warn("{}", std::string_view(line.data(), line.size()));
+}
+
+void RequestTracer::queueSpan(const RequestTrace &trace,
+                              std::string_view route, unsigned status) {
+  if (!trace.reached(RequestPhase::HeaderRead) ||
+      !trace.reached(RequestPhase::LastByte)) {
+    return;
+  }
+  Ring &ring = localRing();
+  size_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) == ring.slots.size()) {
+    dropped.add();
+    return;
+  }
+  auto &span = ring.slots[head & (ring.slots.size() - 1)];
+  span.trace = trace;
+  span.route = route;
+  span.status = status;
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+RequestTracer::Ring &RequestTracer::localRing() {
+  thread_local Ring *ring = nullptr;
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.push_back(std::make_unique<Ring>(options.ringCapacity));
+    ring = rings.back().get();
+  }
+  return *ring;
+}
+
+void RequestTracer::run() {
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (!stopping) {
+    wake.wait_for(lock, options.flushInterval, [this] { return stopping; });
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+  lock.unlock();
+  drain(); // what was queued before close
+}
+
+void RequestTracer::drain() {
+  std::vector<Ring *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (auto &ring : rings) {
+      snapshot.push_back(ring.get());
+    }
+  }
+  // Traces are stamped on the steady clock; spans carry wall-clock time.
+  auto clockOffset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch() -
+      RequestTrace::Clock::now().time_since_epoch());
+  batch.clear();
+  for (Ring *ring : snapshot) {
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    size_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      formatSpan(ring->slots[tail & (ring->slots.size() - 1)], clockOffset,
+                 batch);
+      written.add();
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+  if (batch.size() > 0 &&
+      (std::fwrite(batch.data(), 1, batch.size(), file.get()) !=
+           batch.size() ||
+       std::fflush(file.get()) != 0)) {
+    spdlog::error("span file write failed: {}", options.spanFile);
+  }
+}
+
+void RequestTracer::formatSpan(const PendingSpan &span,
+                               std::chrono::nanoseconds clockOffset,
+                               fmt::memory_buffer &out) {
+  const auto &trace = span.trace;
+  auto unixNanos = [&](RequestTrace::Clock::time_point at) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               at.time_since_epoch() + clockOffset)
+        .count();
+  };
+  auto traceId = detail::randomTraceId<16>();
+  auto rootId = detail::randomTraceId<8>();
+  std::string_view traceIdView(traceId.data(), traceId.size());
+  std::string_view rootIdView(rootId.data(), rootId.size());
+
+  auto to = std::back_inserter(out);
+  fmt::format_to(to, R"({{"resourceSpans":[{{"resource":{{"attributes":[)"
+                     R"({{"key":"service.name","value":{{"stringValue":)"
+                     R"("cms"}}}}]}},"scopeSpans":[{{"scope":{{"name":)"
+                     R"("cms"}},"spans":[)");
+  // The request, from being read to its last byte, spans the server time.
+  fmt::format_to(to,
+                 R"({{"traceId":"{}","spanId":"{}","name":"{} {}","kind":2,)"
+                 R"("startTimeUnixNano":"{}","endTimeUnixNano":"{}",)"
+                 R"("attributes":[{{"key":"http.request.method","value":)"
+                 R"({{"stringValue":"{}"}}}},{{"key":"http.route","value":)"
+                 R"({{"stringValue":"{}"}}}},{{"key":"url.path","value":)"
+                 R"({{"stringValue":)",
+                 traceIdView, rootIdView, trace.method(), span.route,
+                 unixNanos(trace.at(RequestPhase::HeaderRead)),
+                 unixNanos(trace.at(RequestPhase::LastByte)), trace.method(),
+                 span.route);
+  detail::appendJsonString(out, trace.target());
+  fmt::format_to(to,
+                 R"(}}}},{{"key":"http.response.status_code","value":)"
+                 R"({{"intValue":"{}"}}}}]}})",
+                 span.status);
+  // Its phases after the read as children, each from the previous stamp.
+  std::array<RequestPhase, kRequestPhaseCount> phases;
+  size_t count = trace.ordered(phases);
+  for (size_t i = 1; i < count; ++i) {
+    if (trace.at(phases[i - 1]) < trace.at(RequestPhase::HeaderRead)) {
+      continue;
+    }
+    auto spanId = detail::randomTraceId<8>();
+    fmt::format_to(to,
+                   R"(,{{"traceId":"{}","spanId":"{}","parentSpanId":"{}",)"
+                   R"("name":"{}","kind":1,"startTimeUnixNano":"{}",)"
+                   R"("endTimeUnixNano":"{}"}})",
+                   traceIdView,
+                   std::string_view(spanId.data(), spanId.size()), rootIdView,
+                   kRequestPhaseNames[static_cast<size_t>(phases[i])],
+                   unixNanos(trace.at(phases[i - 1])),
+                   unixNanos(trace.at(phases[i])));
+  }
+  fmt::format_to(to, "]}}]}}]}}\n");
+}
+
+void RequestTracer::writeMetrics(std::string &out) const {
+  writeMetricHeader(out, "cms_trace_spans_total", "counter",
+                    "Request spans written to the span file.");
+  writeSample(out, "cms_trace_spans_total", "", written.value());
+  writeMetricHeader(out, "cms_trace_spans_dropped_total", "counter",
+                    "Request spans dropped because a ring was full.");
+  writeSample(out, "cms_trace_spans_dropped_total", "", dropped.value());
+}
+
+} // namespace services
+
+#endif // CMS_REQUEST_TRACE_HPP
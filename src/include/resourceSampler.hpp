@@ -0,0 +1,378 @@
+#pragma once
+
+#ifndef CMS_RESOURCE_SAMPLER_HPP
+#define CMS_RESOURCE_SAMPLER_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "allocator.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace services {
+
+struct ThreadCpuTime {
+  long tid = 0;
+  std::string name;
+  double userSeconds = 0;
+  double systemSeconds = 0;
+};
+
+// One reading of the process's resource usage from procfs.
+struct ResourceSample {
+  uint64_t residentBytes = 0;
+  uint64_t residentPeakBytes = 0;
+  double userSeconds = 0;
+  double systemSeconds = 0;
+  uint64_t minorFaults = 0;
+  uint64_t majorFaults = 0;
+  uint64_t voluntarySwitches = 0;
+  uint64_t involuntarySwitches = 0;
+  uint64_t threads = 0;
+  uint64_t openFds = 0;
+  uint64_t maxFds = 0;
+  std::optional<cms::AllocatorStats> allocator;
+  std::vector<ThreadCpuTime> threadCpu;
+};
+
+namespace detail {
+
+// Fields of a /proc stat line after "pid (comm)", numbered as in proc(5):
+// fields[0] is field 3, the state.
+std::vector<std::string_view> procStatFields(std::string_view line,
+                                             std::string_view *comm) {
+  std::vector<std::string_view> fields;
+  auto open = line.find('(');
+  auto close = line.rfind(')');
+  if (open == std::string_view::npos || close == std::string_view::npos) {
+    return fields;
+  }
+  if (comm) {
+    *comm = line.substr(open + 1, close - open - 1);
+  }
+  size_t position = close + 1;
+  while (position < line.size()) {
+    while (position < line.size() && line[position] == ' ') {
+      ++position;
+    }
+    size_t end = line.find(' ', position);
+    end = end == std::string_view::npos ? line.size() : end;
+    if (end > position) {
+      fields.push_back(line.substr(position, end - position));
+    }
+    position = end;
+  }
+  return fields;
+}
+
+uint64_t procNumber(std::string_view text) {
+  uint64_t value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      break;
+    }
+    value = value * 10 + static_cast<uint64_t>(c - '0');
+  }
+  return value;
+}
+
+std::string readProcFile(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+} // namespace detail
+
+// Read the process's current usage: memory and context switches from
+// /proc/self/status, CPU and faults from /proc/self/stat, CPU per thread
+// from /proc/self/task/*/stat, open descriptors from /proc/self/fd.
+ResourceSample sampleResources() {
+  ResourceSample sample;
+  const double ticks = static_cast<double>(::sysconf(_SC_CLK_TCK));
+
+  std::istringstream status(detail::readProcFile("/proc/self/status"));
+  for (std::string line; std::getline(status, line);) {
+    auto colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string_view key(line.data(), colon);
+    std::string_view value(line);
+    value.remove_prefix(
+        std::min(value.find_first_not_of(" \t", colon + 1), value.size()));
+    if (key == "VmRSS") {
+      sample.residentBytes = detail::procNumber(value) << 10;
+    } else if (key == "VmHWM") {
+      sample.residentPeakBytes = detail::procNumber(value) << 10;
+    } else if (key == "Threads") {
+      sample.threads = detail::procNumber(value);
+    } else if (key == "voluntary_ctxt_switches") {
+      sample.voluntarySwitches = detail::procNumber(value);
+    } else if (key == "nonvoluntary_ctxt_switches") {
+      sample.involuntarySwitches = detail::procNumber(value);
+    }
+  }
+
+  auto stat = detail::readProcFile("/proc/self/stat");
+  auto fields = detail::procStatFields(stat, nullptr);
+  if (fields.size() > 12) {
+    sample.minorFaults = detail::procNumber(fields[7]);
+    sample.majorFaults = detail::procNumber(fields[9]);
+    sample.userSeconds = detail::procNumber(fields[11]) / ticks;
+    sample.systemSeconds = detail::procNumber(fields[12]) / ticks;
+  }
+
+  // The error_code overloads throughout: a thread or descriptor may go away
+  // mid-walk, and the sampler thread must not throw.
+  std::error_code ec;
+  for (auto it = std::filesystem::directory_iterator("/proc/self/task", ec);
+       !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+    auto name = it->path().filename().string();
+    long tid = 0;
+    auto [end, parsed] =
+        std::from_chars(name.data(), name.data() + name.size(), tid);
+    if (parsed != std::errc() || end != name.data() + name.size()) {
+      continue;
+    }
+    auto line = detail::readProcFile(it->path() / "stat");
+    std::string_view comm;
+    auto taskFields = detail::procStatFields(line, &comm);
+    if (taskFields.size() > 12) {
+      sample.threadCpu.push_back(
+          ThreadCpuTime{tid, std::string(comm),
+                        detail::procNumber(taskFields[11]) / ticks,
+                        detail::procNumber(taskFields[12]) / ticks});
+    }
+  }
+
+  ec.clear();
+  for (auto it = std::filesystem::directory_iterator("/proc/self/fd", ec);
+       !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+    ++sample.openFds;
+  }
+  struct rlimit files {};
+  if (::getrlimit(RLIMIT_NOFILE, &files) == 0) {
+    sample.maxFds = files.rlim_cur;
+  }
+
+  sample.allocator = cms::allocatorStats();
+  return sample;
+}
+
+/**
+ * Samples the process's resource usage in the background and keeps the
+ * latest reading for the metrics endpoint, so a scrape never walks procfs.
+ * Logs a warning when resident memory crosses a share of the cgroup memory
+ * limit, once per crossing.
+ */
+class ResourceSampler {
+public:
+  struct Options {
+    std::chrono::seconds interval{15};
+    std::optional<double> cpuQuota; // from the cgroup, exported as is
+    std::optional<uint64_t> memoryLimit;
+    double memoryWarnRatio = 0.9;
+  };
+
+  static ResourceSampler &instance();
+
+  ~ResourceSampler();
+
+  void start(Options configured);
+  void stop();
+
+  ResourceSample latest() const;
+
+  void writeMetrics(std::string &out) const;
+
+private:
+  ResourceSampler() = default;
+
+  void run();
+  void sample();
+
+  Options options;
+  mutable std::mutex sampleMutex;
+  ResourceSample last;
+  bool overMemoryWarning = false;
+
+  std::thread sampler;
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+};
+
+ResourceSampler &ResourceSampler::instance() {
+  static ResourceSampler resourceSampler;
+  return resourceSampler;
+}
+
+ResourceSampler::~ResourceSampler() { stop(); }
+
+void ResourceSampler::start(Options configured) {
+  options = std::move(configured);
+  sample();
+  stopping = false;
+  sampler = std::thread([this] { run(); });
+}
+
+void ResourceSampler::stop() {
+  if (!sampler.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  sampler.join();
+}
+
+void ResourceSampler::run() {
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (!wake.wait_for(lock, options.interval, [this] { return stopping; })) {
+    lock.unlock();
+    sample();
+    lock.lock();
+  }
+}
+
+void ResourceSampler::sample() {
+  ResourceSample current;
+  try {
+    current = sampleResources();
+  } catch (const std::exception &e) {
+    // Keep the previous reading rather than end the process.
+    spdlog::warn("resource sample failed: {}", e.what());
+    return;
+  }
+  if (options.memoryLimit) {
+    double used =
+        static_cast<double>(current.residentBytes) / *options.memoryLimit;
+    if (used >= options.memoryWarnRatio && !overMemoryWarning) {
+      spdlog::warn("resident memory at {:.0f}% of the cgroup limit "
+                   "rss_bytes={} limit_bytes={}",
+                   used * 100, current.residentBytes, *options.memoryLimit);
+    }
+    overMemoryWarning = used >= options.memoryWarnRatio;
+  }
+  std::lock_guard<std::mutex> lock(sampleMutex);
+  last = std::move(current);
+}
+
+ResourceSample ResourceSampler::latest() const {
+  std::lock_guard<std::mutex> lock(sampleMutex);
+  return last;
+}
+
+void ResourceSampler::writeMetrics(std::string &out) const {
+  auto current = latest();
+  auto to = std::back_inserter(out);
+
+  writeMetricHeader(out, "cms_process_resident_memory_bytes", "gauge",
+                    "Resident set size.");
+  writeSample(out, "cms_process_resident_memory_bytes", "",
+              current.residentBytes);
+  writeMetricHeader(out, "cms_process_resident_memory_peak_bytes", "gauge",
+                    "Highest resident set size so far.");
+  writeSample(out, "cms_process_resident_memory_peak_bytes", "",
+              current.residentPeakBytes);
+  writeMetricHeader(out, "cms_process_cpu_seconds_total", "counter",
+                    "CPU time of the process by mode.");
+  fmt::format_to(to,
+                 "cms_process_cpu_seconds_total{{mode=\"user\"}} {}\n"
+                 "cms_process_cpu_seconds_total{{mode=\"system\"}} {}\n",
+                 current.userSeconds, current.systemSeconds);
+  writeMetricHeader(out, "cms_process_page_faults_total", "counter",
+                    "Page faults by kind.");
+  writeSample(out, "cms_process_page_faults_total", "kind=\"minor\"",
+              current.minorFaults);
+  writeSample(out, "cms_process_page_faults_total", "kind=\"major\"",
+              current.majorFaults);
+  writeMetricHeader(out, "cms_process_context_switches_total", "counter",
+                    "Context switches by kind.");
+  writeSample(out, "cms_process_context_switches_total",
+              "kind=\"voluntary\"", current.voluntarySwitches);
+  writeSample(out, "cms_process_context_switches_total",
+              "kind=\"involuntary\"", current.involuntarySwitches);
+  writeMetricHeader(out, "cms_process_threads", "gauge", "Threads.");
+  writeSample(out, "cms_process_threads", "", current.threads);
+  writeMetricHeader(out, "cms_process_open_fds", "gauge",
+                    "Open file descriptors.");
+  writeSample(out, "cms_process_open_fds", "", current.openFds);
+  writeMetricHeader(out, "cms_process_max_fds", "gauge",
+                    "Limit on open file descriptors.");
+  writeSample(out, "cms_process_max_fds", "", current.maxFds);
+
+  writeMetricHeader(out, "cms_thread_cpu_seconds_total", "counter",
+                    "CPU time of each thread, user plus system.");
+  for (const auto &thread : current.threadCpu) {
+    fmt::format_to(to,
+                   "cms_thread_cpu_seconds_total{{tid=\"{}\",name=\"{}\"}} "
+                   "{}\n",
+                   thread.tid, escapeLabelValue(thread.name),
+                   thread.userSeconds + thread.systemSeconds);
+  }
+
+  if (current.allocator) {
+    const auto &allocator = *current.allocator;
+    auto labels = fmt::format("allocator=\"{}\"", allocator.allocator);
+    if (allocator.inUseBytes) {
+      writeMetricHeader(out, "cms_allocator_in_use_bytes", "gauge",
+                        "Heap bytes allocated to the program.");
+      writeSample(out, "cms_allocator_in_use_bytes", labels,
+                  *allocator.inUseBytes);
+    }
+    writeMetricHeader(out, "cms_allocator_held_bytes", "gauge",
+                      "Heap bytes the allocator has taken from the OS.");
+    writeSample(out, "cms_allocator_held_bytes", labels, allocator.heldBytes);
+    if (auto fragmentation = allocator.fragmentation()) {
+      writeMetricHeader(out, "cms_allocator_fragmentation_ratio", "gauge",
+                        "Share of held heap bytes not allocated.");
+      fmt::format_to(to, "cms_allocator_fragmentation_ratio{{{}}} {}\n",
+                     labels, *fragmentation);
+    }
+  }
+
+  if (options.cpuQuota) {
+    writeMetricHeader(out, "cms_cgroup_cpu_quota", "gauge",
+                      "CPUs the cgroup may use.");
+    fmt::format_to(to, "cms_cgroup_cpu_quota {}\n", *options.cpuQuota);
+  }
+  if (options.memoryLimit) {
+    writeMetricHeader(out, "cms_cgroup_memory_limit_bytes", "gauge",
+                      "Memory limit of the cgroup.");
+    writeSample(out, "cms_cgroup_memory_limit_bytes", "",
+                *options.memoryLimit);
+  }
+}
+
+} // namespace services
+
+#endif // CMS_RESOURCE_SAMPLER_HPP
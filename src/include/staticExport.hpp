@@ -0,0 +1,393 @@
+#pragma once
+
+#ifndef CMS_STATIC_EXPORT_HPP
+#define CMS_STATIC_EXPORT_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "content.hpp"
+#include "contentStore.hpp"
+#include "markdown.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <zlib.h>
+#ifdef CMS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace cms {
+
+/**
+ * Renders every page and post of each database to HTML files under a
+ * directory, with precompressed .gz (and .zst, when built with libzstd)
+ * siblings for sendfile servers such as nginx gzip_static.
+ *
+ * Paths mirror the request targets:
+ *   /            -> <dir>/<db>/index.html
+ *   /<pageId>    -> <dir>/<db>/<pageId>.html
+ *   /posts/<id>  -> <dir>/<db>/posts/<id>.html
+ *
+ * Each file's mtime is set to the document's updatedAt, so a later export
+ * only re-renders documents that changed since. Layout edits do not touch
+ * the documents, so <dir>/.layouts records a hash of each layout the last
+ * export used (with the cmark version and options, see markdownHash); a
+ * document whose layout hash changed is re-rendered whatever its mtime.
+ */
+class StaticExporter {
+public:
+  struct Result {
+    size_t rendered = 0;
+    size_t unchanged = 0;
+    size_t failed = 0;
+    std::chrono::duration<double> elapsed{0};
+
+    double documentsPerSecond() const {
+      return elapsed.count() > 0 ? (rendered + unchanged) / elapsed.count()
+                                 : 0.0;
+    }
+  };
+
+  StaticExporter(const Content &contentRef, const string &outputDirectory,
+                 unsigned threadCount);
+
+  Result run(const std::vector<std::string_view> &databases);
+
+private:
+  struct Job {
+    string dbName;
+    std::string_view collectionName;
+    ContentIdType idType;
+    string id;
+    std::filesystem::path path;
+  };
+
+  enum class Outcome { Rendered, Unchanged, Failed };
+
+  // Layout hashes by "<db> <layoutId>", as recorded in the manifest.
+  using LayoutHashes = std::map<string, uint64_t>;
+
+  Outcome exportDocument(const Job &job);
+
+  LayoutHashes readManifest() const;
+  void writeManifest(const LayoutHashes &hashes) const;
+
+  // directory/<name><extension>, or nothing when name is not a plain file
+  // name or the path would resolve outside root.
+  std::optional<std::filesystem::path>
+  outputPath(const std::filesystem::path &directory, std::string_view name,
+             std::string_view extension = {}) const;
+
+  static bool isCurrent(const std::filesystem::path &path, int64_t updatedAt);
+  static void writeFile(const std::filesystem::path &path,
+                        std::string_view data, int64_t updatedAt);
+  static string gzip(std::string_view data);
+#ifdef CMS_HAVE_ZSTD
+  static string zstd(std::string_view data);
+#endif
+
+  const Content &content;
+  std::filesystem::path root;
+  std::filesystem::path canonicalRoot; // root with symlinks resolved
+  unsigned threads;
+
+  LayoutHashes exportedLayouts; // from the previous export, read only
+  std::mutex layoutsMutex;
+  LayoutHashes currentLayouts;
+  std::set<string> failedLayouts; // left out of the manifest to retry
+};
+
+StaticExporter::StaticExporter(const Content &contentRef,
+                               const string &outputDirectory,
+                               unsigned threadCount)
+    : content(contentRef), root(outputDirectory),
+      threads(std::max(1u, threadCount)) {
+  if (outputDirectory.empty()) {
+    throw std::invalid_argument("Invalid static export directory");
+  }
+}
+
+StaticExporter::Result
+StaticExporter::run(const std::vector<std::string_view> &databases) {
+  auto start = std::chrono::steady_clock::now();
+  auto &store = *content.getStore();
+  exportedLayouts = readManifest();
+  currentLayouts.clear();
+  failedLayouts.clear();
+  canonicalRoot = std::filesystem::weakly_canonical(root);
+
+  // Ids come from the store, so one naming a path outside root is skipped.
+  size_t rejected = 0;
+  std::vector<Job> jobs;
+  for (auto dbName : databases) {
+    auto dbRoot = outputPath(root, dbName);
+    if (!dbRoot) {
+      spdlog::error("Skipping database {}: not a plain directory name",
+                    dbName);
+      ++rejected;
+      continue;
+    }
+    for (auto &id : store.listIds(dbName, "pages")) {
+      if (auto path = outputPath(*dbRoot, id, ".html")) {
+        jobs.push_back(Job{string(dbName), "pages", ContentIdType::String,
+                           std::move(id), std::move(*path)});
+      } else {
+        spdlog::error("Skipping {}.pages ({}): not a plain file name", dbName,
+                      id);
+        ++rejected;
+      }
+    }
+    for (auto &id : store.listIds(dbName, "posts")) {
+      if (auto path = outputPath(*dbRoot / "posts", id, ".html")) {
+        jobs.push_back(Job{string(dbName), "posts", ContentIdType::Integer,
+                           std::move(id), std::move(*path)});
+      } else {
+        spdlog::error("Skipping {}.posts ({}): not a plain file name", dbName,
+                      id);
+        ++rejected;
+      }
+    }
+  }
+
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> rendered{0};
+  std::atomic<size_t> unchanged{0};
+  std::atomic<size_t> failed{0};
+  auto worker = [&] {
+    for (size_t i = next++; i < jobs.size(); i = next++) {
+      switch (exportDocument(jobs[i])) {
+      case Outcome::Rendered:
+        ++rendered;
+        break;
+      case Outcome::Unchanged:
+        ++unchanged;
+        break;
+      case Outcome::Failed:
+        ++failed;
+        break;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  auto workerCount =
+      std::min<size_t>(threads, std::max<size_t>(1, jobs.size()));
+  workers.reserve(workerCount - 1);
+  for (size_t i = 1; i < workerCount; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : workers) {
+    thread.join();
+  }
+
+  for (const auto &layout : failedLayouts) {
+    currentLayouts.erase(layout);
+  }
+  try {
+    writeManifest(currentLayouts);
+  } catch (const std::exception &e) {
+    // Only costs re-rendering everything on the next run.
+    spdlog::warn("Static export manifest not written: {}", e.what());
+  }
+
+  Result result;
+  result.rendered = rendered;
+  result.unchanged = unchanged;
+  result.failed = failed + rejected;
+  result.elapsed = std::chrono::steady_clock::now() - start;
+  return result;
+}
+
+std::optional<std::filesystem::path>
+StaticExporter::outputPath(const std::filesystem::path &directory,
+                           std::string_view name,
+                           std::string_view extension) const {
+  if (name.empty() || name == "." ||
+      name.find_first_of("/\\") != std::string_view::npos ||
+      name.find("..") != std::string_view::npos) {
+    return std::nullopt;
+  }
+  auto path = directory / string(name).append(extension);
+  // A symlinked directory under root could still point elsewhere.
+  auto resolved = std::filesystem::weakly_canonical(path);
+  auto relative = resolved.lexically_relative(canonicalRoot);
+  if (relative.empty() || *relative.begin() == "..") {
+    return std::nullopt;
+  }
+  return path;
+}
+
+StaticExporter::Outcome StaticExporter::exportDocument(const Job &job) {
+  string layoutKey;
+  try {
+    auto document = content.getStore()->getDocument(
+        job.dbName, job.collectionName, job.idType, job.id);
+    if (!document) {
+      spdlog::warn("Skipping {}.{} ({}) without mode or layout", job.dbName,
+                   job.collectionName, job.id);
+      return Outcome::Failed;
+    }
+    layoutKey = fmt::format("{} {}", job.dbName, document->layoutId);
+    uint64_t layoutHash =
+        markdownHash(string(document->header).append(document->footer));
+    {
+      std::lock_guard<std::mutex> lock(layoutsMutex);
+      currentLayouts[layoutKey] = layoutHash;
+    }
+    auto exported = exportedLayouts.find(layoutKey);
+    if (exported != exportedLayouts.end() && exported->second == layoutHash &&
+        isCurrent(job.path, document->updatedAt)) {
+      return Outcome::Unchanged;
+    }
+
+    auto html = content.renderDocument(
+        job.dbName, contentPath(job.collectionName, job.id), *document);
+    std::filesystem::create_directories(job.path.parent_path());
+    // Siblings first: a current .html implies current compressed copies.
+    writeFile(job.path.string() + ".gz", gzip(html), document->updatedAt);
+#ifdef CMS_HAVE_ZSTD
+    writeFile(job.path.string() + ".zst", zstd(html), document->updatedAt);
+#endif
+    writeFile(job.path, html, document->updatedAt);
+    spdlog::debug("Exported {}", job.path.string());
+    return Outcome::Rendered;
+  } catch (const std::exception &e) {
+    spdlog::error("Static export of {}.{} ({}) failed: {}", job.dbName,
+                  job.collectionName, job.id, e.what());
+    if (!layoutKey.empty()) {
+      std::lock_guard<std::mutex> lock(layoutsMutex);
+      failedLayouts.insert(layoutKey);
+    }
+    return Outcome::Failed;
+  }
+}
+
+bool StaticExporter::isCurrent(const std::filesystem::path &path,
+                               int64_t updatedAt) {
+  // Without an updatedAt there is nothing to compare against.
+  if (updatedAt == 0) {
+    return false;
+  }
+  struct stat fileStat;
+  if (stat(path.c_str(), &fileStat) == -1) {
+    return false;
+  }
+  int64_t modifiedAt = static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000 +
+                       fileStat.st_mtim.tv_nsec / 1000000;
+  return modifiedAt == updatedAt;
+}
+
+void StaticExporter::writeFile(const std::filesystem::path &path,
+                               std::string_view data, int64_t updatedAt) {
+  // Write beside the target and rename, so readers never see a partial file.
+  string temporaryPath = path.string() + ".tmp";
+  std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Unable to create " + temporaryPath + ": " +
+                             std::strerror(errno));
+  }
+  bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  written = std::fclose(file) == 0 && written;
+  if (!written) {
+    std::remove(temporaryPath.c_str());
+    throw std::runtime_error("Unable to write " + temporaryPath);
+  }
+
+  if (updatedAt != 0) {
+    struct timespec times[2];
+    times[0].tv_sec = updatedAt / 1000;
+    times[0].tv_nsec = (updatedAt % 1000) * 1000000;
+    times[1] = times[0];
+    if (utimensat(AT_FDCWD, temporaryPath.c_str(), times, 0) == -1) {
+      spdlog::warn("Unable to set the mtime of {}, so it will be exported "
+                   "again next run: {}",
+                   path.string(), std::strerror(errno));
+    }
+  }
+  std::filesystem::rename(temporaryPath, path);
+}
+
+StaticExporter::LayoutHashes StaticExporter::readManifest() const {
+  LayoutHashes hashes;
+  std::ifstream manifest(root / ".layouts");
+  string dbName;
+  int layoutId;
+  uint64_t hash;
+  while (manifest >> dbName >> layoutId >> std::hex >> hash >> std::dec) {
+    hashes[fmt::format("{} {}", dbName, layoutId)] = hash;
+  }
+  return hashes;
+}
+
+void StaticExporter::writeManifest(const LayoutHashes &hashes) const {
+  std::filesystem::create_directories(root);
+  string manifest;
+  for (const auto &[layout, hash] : hashes) {
+    manifest += fmt::format("{} {:016x}\n", layout, hash);
+  }
+  writeFile(root / ".layouts", manifest, 0);
+}
+
+string StaticExporter::gzip(std::string_view data) {
+  z_stream stream{};
+  // windowBits 15 + 16 selects the gzip wrapper instead of zlib's.
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("Unable to initialize gzip");
+  }
+  string compressed(deflateBound(&stream, data.size()), '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+  stream.avail_out = static_cast<uInt>(compressed.size());
+  int status = deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    throw std::runtime_error("Unable to gzip document");
+  }
+  return compressed;
+}
+
+#ifdef CMS_HAVE_ZSTD
+string StaticExporter::zstd(std::string_view data) {
+  string compressed(ZSTD_compressBound(data.size()), '\0');
+  size_t size = ZSTD_compress(compressed.data(), compressed.size(),
+                              data.data(), data.size(), 19);
+  if (ZSTD_isError(size)) {
+    throw std::runtime_error(string("Unable to zstd document: ") +
+                             ZSTD_getErrorName(size));
+  }
+  compressed.resize(size);
+  return compressed;
+}
+#endif
+
+} // namespace cms
+
+#endif // CMS_STATIC_EXPORT_HPP
@@ -3,8 +3,14 @@
 #ifndef CMS_STRING_UTIL_HPP
 #define CMS_STRING_UTIL_HPP
 
+#include "byteSearch.hpp"
+#include "dateFormat.hpp"
+
+#include <algorithm>
+#include <array>
 #include <boost/optional.hpp>
 #include <bsoncxx/types.hpp>
+#include <cassert>
 #include <cerrno>
 #include <charconv>
 #include <chrono>
@@ -14,10 +20,13 @@
 #include <iomanip>
 #include <iostream>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <string>
 #include <sys/sysinfo.h>
 #include <sys/utsname.h>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace string_util {
 
@@ -142,18 +151,179 @@ void StringReplacer::performReplacement(string_view input,
   }
 }
 
+/**
+ * Replaces several needles in a single scan. The needles' first bytes are
+ * compiled into a candidate set and only candidate positions are compared
+ * against the needles. A single first byte (e.g. every %PLACEHOLDER%) is
+ * found with memchr; up to four are searched a vector at a time with
+ * cms::findAnyByte; larger sets fall back to a 256-entry table lookup per
+ * byte. Where needles overlap at a position the
+ * longest one wins.
+ */
+class MultiStringReplacer {
+public:
+  explicit MultiStringReplacer(
+      std::vector<std::pair<string, string>> replacements);
+  ~MultiStringReplacer() = default;
+
+  // Thread-safe. The input is scanned once, recording the matches, and the
+  // output is then built in a buffer of exactly its final size.
+  string replace(string_view input) const;
+
+private:
+  static constexpr size_t kMaxVectorFirstBytes = 4;
+  // Matches recorded on the stack before spilling to the heap.
+  static constexpr size_t kInlineMatches = 64;
+
+  struct Match {
+    size_t pos;
+    size_t index; // into pairs_
+  };
+
+  // Position of the next byte that starts some needle, or npos.
+  size_t nextCandidate(string_view input, size_t pos) const;
+
+  // Index of the needle matching at pos, or npos.
+  size_t matchAt(string_view input, size_t pos) const;
+
+  // Calls onMatch with each non-overlapping match, left to right.
+  template <typename OnMatch>
+  void scan(string_view input, OnMatch &&onMatch) const;
+
+  std::vector<std::pair<string, string>> pairs_;
+  std::array<bool, 256> isFirst_{};
+  std::vector<char> firstBytes_;
+};
+
+/**
+   Usage:
+   string_util::MultiStringReplacer replacer({{"%A%", "a"}, {"%B%", "b"}});
+   std::string result = replacer.replace("%A% and %B%"); // "a and b"
+ **/
+
+MultiStringReplacer::MultiStringReplacer(
+    std::vector<std::pair<string, string>> replacements)
+    : pairs_(std::move(replacements)) {
+  std::stable_sort(pairs_.begin(), pairs_.end(),
+                   [](const auto &left, const auto &right) {
+                     return left.first.size() > right.first.size();
+                   });
+  for (const auto &[needle, replacement] : pairs_) {
+    if (needle.empty()) {
+      throw std::invalid_argument("MultiStringReplacer needle cannot be empty");
+    }
+    auto first = static_cast<unsigned char>(needle.front());
+    if (!isFirst_[first]) {
+      isFirst_[first] = true;
+      firstBytes_.push_back(needle.front());
+    }
+  }
+}
+
+size_t MultiStringReplacer::nextCandidate(string_view input,
+                                          size_t pos) const {
+  const char *data = input.data();
+  const size_t size = input.size();
+  const size_t count = firstBytes_.size();
+  if (count == 1) {
+    if (pos >= size) {
+      return string_view::npos;
+    }
+    auto *found = static_cast<const char *>(
+        std::memchr(data + pos, firstBytes_[0], size - pos));
+    return found ? static_cast<size_t>(found - data) : string_view::npos;
+  }
+  if (count <= kMaxVectorFirstBytes) {
+    switch (count) {
+    case 2:
+      pos = cms::findAnyByte<2>(input, firstBytes_.data(), pos);
+      break;
+    case 3:
+      pos = cms::findAnyByte<3>(input, firstBytes_.data(), pos);
+      break;
+    default:
+      pos = cms::findAnyByte<kMaxVectorFirstBytes>(input, firstBytes_.data(),
+                                                   pos);
+    }
+    return pos < size ? pos : string_view::npos;
+  }
+  for (; pos < size; ++pos) {
+    if (isFirst_[static_cast<unsigned char>(data[pos])]) {
+      return pos;
+    }
+  }
+  return string_view::npos;
+}
+
+size_t MultiStringReplacer::matchAt(string_view input, size_t pos) const {
+  for (size_t i = 0; i < pairs_.size(); ++i) {
+    const auto &needle = pairs_[i].first;
+    if (needle.front() == input[pos] &&
+        input.compare(pos, needle.size(), needle) == 0) {
+      return i;
+    }
+  }
+  return string_view::npos;
+}
+
+template <typename OnMatch>
+void MultiStringReplacer::scan(string_view input, OnMatch &&onMatch) const {
+  size_t pos = 0;
+  while ((pos = nextCandidate(input, pos)) != string_view::npos) {
+    size_t index = matchAt(input, pos);
+    if (index == string_view::npos) {
+      ++pos;
+      continue;
+    }
+    onMatch(Match{pos, index});
+    pos += pairs_[index].first.size();
+  }
+}
+
+string MultiStringReplacer::replace(string_view input) const {
+  std::array<Match, kInlineMatches> inlineMatches;
+  std::vector<Match> moreMatches;
+  size_t count = 0;
+  size_t outputSize = input.size();
+  scan(input, [&](const Match &match) {
+    const auto &[needle, replacement] = pairs_[match.index];
+    outputSize = outputSize - needle.size() + replacement.size();
+    if (count < kInlineMatches) {
+      inlineMatches[count] = match;
+    } else {
+      moreMatches.push_back(match);
+    }
+    ++count;
+  });
+  if (count == 0) {
+    return string(input);
+  }
+
+  string result;
+  result.reserve(outputSize);
+  size_t inputPos = 0;
+  auto emit = [&](const Match &match) {
+    const auto &[needle, replacement] = pairs_[match.index];
+    result.append(input.substr(inputPos, match.pos - inputPos));
+    result.append(replacement);
+    inputPos = match.pos + needle.size();
+  };
+  for (size_t i = 0; i < std::min(count, kInlineMatches); ++i) {
+    emit(inlineMatches[i]);
+  }
+  for (const auto &match : moreMatches) {
+    emit(match);
+  }
+  result.append(input.substr(inputPos));
+  return result;
+}
+
 /**
  * Format bsoncxx::types::b_date to human friendly
  * ex: Thu, June 12, 2025 at 10:33 AM UTC
  */
 string timestamp(bsoncxx::types::b_date date) {
-  // Convert milliseconds since epoch to time_point
-  auto timePoint = std::chrono::system_clock::time_point(date.value);
-  auto timeT = std::chrono::system_clock::to_time_t(timePoint);
-  char buffer[40];
-  std::strftime(buffer, sizeof(buffer), "%a, %B %d, %Y at %I:%M %p UTC",
-                std::gmtime(&timeT));
-  return buffer;
+  return string(services::ContentDateCache::format(date.value.count()));
 }
 
 class Converter {
@@ -0,0 +1,380 @@
+#pragma once
+
+#ifndef CMS_TRAFFIC_CAPTURE_HPP
+#define CMS_TRAFFIC_CAPTURE_HPP
+
+/***
+###############################################################################
+# Includes
+###############################################################################
+***/
+#include "metrics.hpp"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace services {
+
+/**
+ * Capture file layout. Integers are LEB128 varints and strings a varint
+ * length followed by the bytes:
+ *
+ *   file    := "CMSCAP01" startUnixMicros record*
+ *   record  := length payload
+ *   payload := arrivalMicros connection version method target
+ *              headerCount (name value)* status responseBytes
+ *
+ * arrivalMicros counts from the start of the capture and connection numbers
+ * the server's connections, so a replay can keep both timing and
+ * concurrency. Bodies are never captured.
+ */
+constexpr std::string_view kCaptureMagic{"CMSCAP01"};
+
+// Request headers a capture keeps; cookies and credentials are left out.
+constexpr std::array<std::string_view, 8> kCapturedHeaders{
+    "Host",          "Accept",          "Accept-Encoding", "Accept-Language",
+    "If-None-Match", "If-Modified-Since", "Range",         "User-Agent"};
+
+using CapturedHeader = std::pair<std::string_view, std::string_view>;
+
+// One request read back from a capture file.
+struct CapturedRequest {
+  uint64_t arrivalMicros = 0;
+  uint64_t connection = 0;
+  unsigned version = 11;
+  std::string method;
+  std::string target;
+  std::vector<std::pair<std::string, std::string>> headers;
+  unsigned status = 0;
+  uint64_t responseBytes = 0;
+};
+
+struct TrafficCaptureFile {
+  uint64_t startUnixMicros = 0;
+  std::vector<CapturedRequest> requests;
+};
+
+namespace detail {
+
+void appendVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void appendCaptureString(std::string &out, std::string_view value) {
+  appendVarint(out, value.size());
+  out.append(value);
+}
+
+// Reads varints and strings off a buffer; a read past its end throws.
+class CaptureCursor {
+public:
+  explicit CaptureCursor(std::string_view bytes) : bytes(bytes) {}
+
+  bool done() const { return position == bytes.size(); }
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (position == bytes.size()) {
+        throw std::out_of_range("truncated capture record");
+      }
+      auto byte = static_cast<unsigned char>(bytes[position++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+    throw std::out_of_range("malformed capture varint");
+  }
+
+  std::string_view string() {
+    uint64_t size = varint();
+    if (size > bytes.size() - position) {
+      throw std::out_of_range("truncated capture record");
+    }
+    auto value = bytes.substr(position, size);
+    position += size;
+    return value;
+  }
+
+private:
+  std::string_view bytes;
+  size_t position = 0;
+};
+
+} // namespace detail
+
+/**
+ * Writes the requests the server receives to a compact binary file for
+ * replaying later (see bench/replay.cpp). A request is encoded on its IO
+ * thread as soon as it has been read and submitted with its status once
+ * answered; submitting appends to a buffer under a short lock, and a
+ * background thread writes the buffer out a few times a second. When the
+ * writer falls behind or the file reaches maxBytes, requests are dropped
+ * and counted instead.
+ */
+class TrafficCapture {
+public:
+  struct Options {
+    std::string path;
+    uint64_t maxBytes = 1ull << 30;
+    size_t maxPendingBytes = 8 << 20;
+    std::chrono::milliseconds flushInterval{200};
+  };
+
+  static TrafficCapture &instance();
+
+  ~TrafficCapture();
+
+  // Create the capture file and start the writer; call before serving.
+  bool open(Options configured);
+
+  // Write out what is buffered and stop the writer.
+  void close();
+
+  bool enabled() const { return running.load(std::memory_order_relaxed); }
+
+  // Number for a new connection, which its requests are captured under.
+  uint64_t nextConnection() {
+    return connections.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Start a record for a request that has just been read.
+  std::string encodeRequest(uint64_t connection, std::string_view method,
+                            std::string_view target, unsigned version,
+                            std::span<const CapturedHeader> headers) const;
+
+  // Finish a record with the response and queue it for writing.
+  void record(std::string &payload, unsigned status, uint64_t responseBytes);
+
+  // Requests captured and dropped, in Prometheus text format.
+  void writeMetrics(std::string &out) const;
+
+private:
+  TrafficCapture() = default;
+
+  void run();
+  void flush();
+
+  Options options;
+  std::atomic<bool> running{false};
+  std::atomic<uint64_t> connections{0};
+  std::chrono::steady_clock::time_point started;
+
+  std::mutex pendingMutex;
+  std::string pending;
+  uint64_t fileBytes = 0; // written plus pending, under pendingMutex
+
+  // Writer thread state.
+  std::thread writer;
+  std::condition_variable wake;
+  bool stopping = false;
+  int fd = -1;
+  std::string writing; // swapped with pending for each write
+
+  Counter captured;
+  Counter dropped;
+};
+
+// Read a whole capture file. A record cut short at the end, as a server
+// stopped mid-write leaves it, is ignored.
+TrafficCaptureFile readTrafficCapture(const std::string &path);
+
+TrafficCapture &TrafficCapture::instance() {
+  static TrafficCapture capture;
+  return capture;
+}
+
+TrafficCapture::~TrafficCapture() { close(); }
+
+bool TrafficCapture::open(Options configured) {
+  options = std::move(configured);
+  fd = ::open(options.path.c_str(),
+              O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    spdlog::error("cannot open traffic capture {}: {}", options.path,
+                  std::strerror(errno));
+    return false;
+  }
+  started = std::chrono::steady_clock::now();
+  pending.assign(kCaptureMagic);
+  detail::appendVarint(
+      pending, std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+                   .count());
+  fileBytes = pending.size();
+  stopping = false;
+  running = true;
+  writer = std::thread([this] { run(); });
+  return true;
+}
+
+void TrafficCapture::close() {
+  if (!running.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+  ::close(fd);
+  fd = -1;
+}
+
+std::string
+TrafficCapture::encodeRequest(uint64_t connection, std::string_view method,
+                              std::string_view target, unsigned version,
+                              std::span<const CapturedHeader> headers) const {
+  std::string payload;
+  payload.reserve(32 + target.size() + headers.size() * 48);
+  detail::appendVarint(
+      payload, std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - started)
+                   .count());
+  detail::appendVarint(payload, connection);
+  detail::appendVarint(payload, version);
+  detail::appendCaptureString(payload, method);
+  detail::appendCaptureString(payload, target);
+  detail::appendVarint(payload, headers.size());
+  for (const auto &[name, value] : headers) {
+    detail::appendCaptureString(payload, name);
+    detail::appendCaptureString(payload, value);
+  }
+  return payload;
+}
+
+void TrafficCapture::record(std::string &payload, unsigned status,
+                            uint64_t responseBytes) {
+  if (!enabled() || payload.empty()) {
+    return;
+  }
+  detail::appendVarint(payload, status);
+  detail::appendVarint(payload, responseBytes);
+  std::string framed;
+  detail::appendVarint(framed, payload.size());
+  std::lock_guard<std::mutex> lock(pendingMutex);
+  size_t size = framed.size() + payload.size();
+  if (pending.size() + size > options.maxPendingBytes ||
+      fileBytes + size > options.maxBytes) {
+    dropped.add();
+    return;
+  }
+  pending.append(framed);
+  pending.append(payload);
+  fileBytes += size;
+  captured.add();
+}
+
+void TrafficCapture::run() {
+  std::unique_lock<std::mutex> lock(pendingMutex);
+  while (!stopping) {
+    wake.wait_for(lock, options.flushInterval, [this] { return stopping; });
+    writing.swap(pending);
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+  writing.swap(pending);
+  lock.unlock();
+  flush(); // what was recorded before close
+}
+
+void TrafficCapture::flush() {
+  size_t offset = 0;
+  while (offset < writing.size()) {
+    ssize_t bytes =
+        ::write(fd, writing.data() + offset, writing.size() - offset);
+    if (bytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      spdlog::error("traffic capture write failed: {}", std::strerror(errno));
+      break;
+    }
+    offset += static_cast<size_t>(bytes);
+  }
+  writing.clear();
+}
+
+void TrafficCapture::writeMetrics(std::string &out) const {
+  writeMetricHeader(out, "cms_traffic_capture_requests_total", "counter",
+                    "Requests written to the traffic capture.");
+  writeSample(out, "cms_traffic_capture_requests_total", "",
+              captured.value());
+  writeMetricHeader(out, "cms_traffic_capture_dropped_total", "counter",
+                    "Requests left out of the traffic capture because the "
+                    "writer was behind or the file was full.");
+  writeSample(out, "cms_traffic_capture_dropped_total", "", dropped.value());
+}
+
+TrafficCaptureFile readTrafficCapture(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to open traffic capture: " + path);
+  }
+  std::string bytes((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+  if (std::string_view(bytes).substr(0, kCaptureMagic.size()) !=
+      kCaptureMagic) {
+    throw std::runtime_error("Not a traffic capture: " + path);
+  }
+
+  TrafficCaptureFile capture;
+  detail::CaptureCursor cursor(
+      std::string_view(bytes).substr(kCaptureMagic.size()));
+  try {
+    capture.startUnixMicros = cursor.varint();
+    while (!cursor.done()) {
+      detail::CaptureCursor fields(cursor.string());
+      CapturedRequest request;
+      request.arrivalMicros = fields.varint();
+      request.connection = fields.varint();
+      request.version = static_cast<unsigned>(fields.varint());
+      request.method = fields.string();
+      request.target = fields.string();
+      uint64_t headerCount = fields.varint();
+      for (uint64_t i = 0; i < headerCount; ++i) {
+        std::string name(fields.string());
+        request.headers.emplace_back(std::move(name), fields.string());
+      }
+      request.status = static_cast<unsigned>(fields.varint());
+      request.responseBytes = fields.varint();
+      capture.requests.push_back(std::move(request));
+    }
+  } catch (const std::out_of_range &) {
+    spdlog::warn("traffic capture {} ends in a partial record after {} "
+                 "requests",
+                 path, capture.requests.size());
+  }
+  return capture;
+}
+
+} // namespace services
+
+#endif // CMS_TRAFFIC_CAPTURE_HPP